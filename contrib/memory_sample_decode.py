@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Decode the binary memory samples written by OpenOCD's
+# '$target_name memory_sample' output and dump commands.
+# Reads a file, or connects to the sample server with host:port.
+
+import socket
+import struct
+import sys
+
+MAGIC = b"OCDSAMPL"
+HEADER = struct.Struct("<8sII")
+RECORD = struct.Struct("<QBBHQ")
+
+
+def open_input(name):
+    if ":" in name:
+        host, port = name.rsplit(":", 1)
+        sock = socket.create_connection((host or "localhost", int(port)))
+        return sock.makefile("rb")
+    return open(name, "rb")
+
+
+def read_exact(f, size):
+    data = b""
+    while len(data) < size:
+        chunk = f.read(size - len(data))
+        if not chunk:
+            break
+        data += chunk
+    return data
+
+
+def main(argv):
+    if len(argv) != 2:
+        print("usage: %s (sample_file | host:port)" % argv[0], file=sys.stderr)
+        return 1
+
+    with open_input(argv[1]) as f:
+        header = read_exact(f, HEADER.size)
+        if len(header) < HEADER.size:
+            print("input too short", file=sys.stderr)
+            return 1
+
+        magic, version, record_size = HEADER.unpack(header)
+        if magic != MAGIC or version != 1 or record_size != RECORD.size:
+            print("not a version 1 memory sample stream", file=sys.stderr)
+            return 1
+
+        first = None
+        while True:
+            data = read_exact(f, RECORD.size)
+            if len(data) < RECORD.size:
+                if data:
+                    print("truncated record", file=sys.stderr)
+                break
+            time_us, bucket, size, _, value = RECORD.unpack(data)
+            if first is None:
+                first = time_us
+            print("%12.6f  %2d  0x%0*x" % ((time_us - first) / 1e6, bucket, size * 2, value),
+                  flush=True)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Decode a binary trace ring dump written by OpenOCD's
+# 'log_trace dump' or 'log_trace dump_on_error' commands.
+
+import struct
+import sys
+import time
+
+MAGIC = b"OCDTRACE"
+HEADER = struct.Struct("<8sII")
+RECORD = struct.Struct("<QIII")
+
+JTAG_QUEUE, DAP_RUN, GDB_PACKET, ERROR = range(1, 5)
+
+
+def signed(value):
+    return value - (1 << 32) if value & (1 << 31) else value
+
+
+def text(value):
+    return value.to_bytes(4, "little").rstrip(b"\0").decode("ascii", "replace")
+
+
+def describe(event, a, b):
+    if event == JTAG_QUEUE:
+        return "jtag_queue  %8d us  result %d" % (a, signed(b))
+    if event == DAP_RUN:
+        return "dap_run                 result %d" % signed(a)
+    if event == GDB_PACKET:
+        return "gdb_packet  %8d us  %r" % (a, text(b))
+    if event == ERROR:
+        return "error       line %d  %r" % (a, text(b))
+    return "event %d  0x%08x 0x%08x" % (event, a, b)
+
+
+def main(argv):
+    if len(argv) != 2:
+        print("usage: %s dump_file" % argv[0], file=sys.stderr)
+        return 1
+
+    with open(argv[1], "rb") as f:
+        data = f.read()
+
+    if len(data) < HEADER.size:
+        print("file too short", file=sys.stderr)
+        return 1
+
+    magic, version, count = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != 1:
+        print("not a version 1 trace ring dump", file=sys.stderr)
+        return 1
+
+    first = None
+    for i in range(count):
+        offset = HEADER.size + i * RECORD.size
+        if offset + RECORD.size > len(data):
+            print("truncated after %d records" % i, file=sys.stderr)
+            break
+        time_us, event, a, b = RECORD.unpack_from(data, offset)
+        if first is None:
+            first = time_us
+            print("# first record at %s.%06d" %
+                  (time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(time_us // 1000000)),
+                   time_us % 1000000))
+        print("%12.6f  %s" % ((time_us - first) / 1e6, describe(event, a, b)))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
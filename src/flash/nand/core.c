@@ -677,6 +677,29 @@ int nand_write_page(struct nand_device *nand, uint32_t page,
 		return nand->controller->write_page(nand, page, data, data_size, oob, oob_size);
 }
 
+int nand_write_pages(struct nand_device *nand, uint32_t page, unsigned int count,
+	uint8_t *data, uint32_t data_size,
+	uint8_t *oob, uint32_t oob_size)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < count; i++) {
+		/* all pages but the last end with cache program, see nand_write_finish() */
+		nand->cache_program_more = nand->use_cache_program && i + 1 < count;
+
+		retval = nand_write_page(nand, page + i,
+			data ? data + i * data_size : NULL, data_size,
+			oob ? oob + i * oob_size : NULL, oob_size);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	nand->cache_program_more = false;
+	nand->cache_program_active = false;
+
+	return retval;
+}
+
 int nand_read_page(struct nand_device *nand, uint32_t page,
 	uint8_t *data, uint32_t data_size,
 	uint8_t *oob, uint32_t oob_size)
@@ -824,26 +847,50 @@ int nand_write_data_page(struct nand_device *nand, uint8_t *data, uint32_t size)
 	return retval;
 }
 
+/*
+ * Program the page loaded into the device. Within a sequence of pages
+ * written by nand_write_pages() with cache program enabled, all pages but
+ * the last use the cache program command: the device is ready again as
+ * soon as the page moved on from its cache register, and the status
+ * reports the result of the previous page. The last page waits until the
+ * array is done.
+ */
 int nand_write_finish(struct nand_device *nand)
 {
 	int retval;
 	uint8_t status;
+	bool cached = nand->cache_program_more;
+	bool after_cached = nand->cache_program_active;
+	uint8_t ready = cached ? NAND_STATUS_READY : NAND_STATUS_TRUE_READY;
+	int timeout = 100;
 
-	nand->controller->command(nand, NAND_CMD_PAGEPROG);
+	nand->controller->command(nand, cached ? NAND_CMD_CACHEDPROG : NAND_CMD_PAGEPROG);
+	nand->cache_program_active = cached;
 
-	retval = nand->controller->nand_ready ?
-		nand->controller->nand_ready(nand, 100) :
-		nand_poll_ready(nand, 100);
-	if (!retval)
+	do {
+		retval = nand->controller->nand_ready ?
+			nand->controller->nand_ready(nand, 100) :
+			nand_poll_ready(nand, 100);
+		if (!retval)
+			return ERROR_NAND_OPERATION_TIMEOUT;
+
+		retval = nand_read_status(nand, &status);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("couldn't read status");
+			return ERROR_NAND_OPERATION_FAILED;
+		}
+	} while ((cached || after_cached) && !(status & ready) && timeout--);
+
+	if ((cached || after_cached) && !(status & ready))
 		return ERROR_NAND_OPERATION_TIMEOUT;
 
-	retval = nand_read_status(nand, &status);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("couldn't read status");
+	if (after_cached && (status & NAND_STATUS_FAIL_N1)) {
+		LOG_ERROR("write operation of the previous page didn't pass, status: 0x%2.2x",
+			status);
 		return ERROR_NAND_OPERATION_FAILED;
 	}
 
-	if (status & NAND_STATUS_FAIL) {
+	if (!cached && (status & NAND_STATUS_FAIL)) {
 		LOG_ERROR("write operation didn't pass, status: 0x%2.2x",
 			status);
 		return ERROR_NAND_OPERATION_FAILED;
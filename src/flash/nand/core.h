@@ -56,6 +56,13 @@ struct nand_device {
 	int page_size;
 	int erase_size;
 	bool use_raw;
+	/* program consecutive pages with the cache program command */
+	bool use_cache_program;
+	/* the page being written is followed by another one, program it with
+	 * the cache program command */
+	bool cache_program_more;
+	/* a cache program was issued, the array may still be busy */
+	bool cache_program_active;
 	int num_blocks;
 	struct nand_block *blocks;
 	struct nand_device *next;
@@ -347,30 +347,11 @@ static int davinci_seek_column(struct nand_device *nand, uint16_t column)
 static int davinci_writepage_tail(struct nand_device *nand,
 	uint8_t *oob, uint32_t oob_size)
 {
-	struct davinci_nand *info = nand->controller_priv;
-	struct target *target = nand->target;
-	uint8_t status;
-
 	if (oob_size)
 		davinci_write_block_data(nand, oob, oob_size);
 
-	/* non-cachemode page program */
-	target_write_u8(target, info->cmd, NAND_CMD_PAGEPROG);
-
-	if (!davinci_nand_ready(nand, 100))
-		return ERROR_NAND_OPERATION_TIMEOUT;
-
-	if (nand_read_status(nand, &status) != ERROR_OK) {
-		LOG_ERROR("couldn't read status");
-		return ERROR_NAND_OPERATION_FAILED;
-	}
-
-	if (status & NAND_STATUS_FAIL) {
-		LOG_ERROR("write operation failed, status: 0x%02x", status);
-		return ERROR_NAND_OPERATION_FAILED;
-	}
-
-	return ERROR_OK;
+	/* page program, or cache program within "nand write" */
+	return nand_write_finish(nand);
 }
 
 /*
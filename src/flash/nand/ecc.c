@@ -42,30 +42,53 @@ static const uint8_t nand_ecc_precalc_table[] = {
 	0x00, 0x55, 0x56, 0x03, 0x59, 0x0c, 0x0f, 0x5a, 0x5a, 0x0f, 0x0c, 0x59, 0x03, 0x56, 0x55, 0x00
 };
 
+static inline uint8_t parity32(uint32_t x)
+{
+	x ^= x >> 16;
+	x ^= x >> 8;
+	x ^= x >> 4;
+	x ^= x >> 2;
+	x ^= x >> 1;
+	return x & 1;
+}
+
 /*
  * nand_calculate_ecc - Calculate 3-byte ECC for 256-byte block
+ *
+ * The column parity is linear, so it's taken from the XOR of all bytes.
+ * Bit k of the line parity is the parity of all the bytes whose index has
+ * bit k set; index bits 0 and 1 select the byte within a 32-bit word, bits
+ * 2 to 7 the word. This needs one pass of word-wide XORs over the block
+ * instead of a table lookup and branch per byte.
  */
 int nand_calculate_ecc(struct nand_device *nand, const uint8_t *dat, uint8_t *ecc_code)
 {
-	uint8_t idx, reg1, reg2, reg3, tmp1, tmp2;
-	int i;
-
-	/* Initialize variables */
-	reg1 = reg2 = reg3 = 0;
-
-	/* Build up column parity */
-	for (i = 0; i < 256; i++) {
-		/* Get CP0 - CP5 from table */
-		idx = nand_ecc_precalc_table[*dat++];
-		reg1 ^= (idx & 0x3f);
-
-		/* All bit XOR = 1 ? */
-		if (idx & 0x40) {
-			reg3 ^= (uint8_t) i;
-			reg2 ^= ~((uint8_t) i);
-		}
+	uint8_t reg1, reg2, reg3, tmp1, tmp2;
+	uint32_t all = 0;
+	uint32_t word_bit[6] = { 0 };
+
+	for (unsigned int i = 0; i < 64; i++) {
+		uint32_t w = le_to_h_u32(dat + 4 * i);
+
+		all ^= w;
+		for (unsigned int k = 0; k < 6; k++)
+			if (i & (1 << k))
+				word_bit[k] ^= w;
 	}
 
+	/* line parity: byte index bits 0 and 1, then 2 to 7 */
+	reg3 = parity32(all & 0xff00ff00);
+	reg3 |= parity32(all & 0xffff0000) << 1;
+	for (unsigned int k = 0; k < 6; k++)
+		reg3 |= parity32(word_bit[k]) << (k + 2);
+
+	/* the complemented line parity differs where an odd number of bytes
+	 * has odd parity, which is the parity of the whole block */
+	reg2 = parity32(all) ? ~reg3 : reg3;
+
+	/* Get CP0 - CP5 from table */
+	reg1 = nand_ecc_precalc_table[(all ^ (all >> 8) ^ (all >> 16) ^ (all >> 24)) & 0xff] & 0x3f;
+
 	/* Create non-inverted ECC code from line parity */
 	tmp1  = (reg3 & 0x80) >> 0; /* B7 -> B7 */
 	tmp1 |= (reg2 & 0x80) >> 1; /* B7 -> B6 */
@@ -62,6 +62,28 @@ static void gf_build_log_exp_table(void)
 	}
 }
 
+/*
+ * The logs of the generator polynomial coefficients, from X^7 down to X^0.
+ */
+static const uint16_t gen_log[8] = {
+	0x21c, 0x181, 0x18e, 0x25f, 0x197, 0x193, 0x237, 0x024,
+};
+
+/*
+ * gen_mul[a][j] is the product of a and the generator polynomial
+ * coefficient j, i.e. the value to subtract from each remainder symbol
+ * when the leading symbol is a. One lookup per symbol instead of a log
+ * and an exponent lookup.
+ */
+static uint16_t gen_mul[1024][8];
+
+static void gf_build_gen_mul_table(void)
+{
+	for (int a = 1; a < 1024; a++)
+		for (int j = 0; j < 8; j++)
+			gen_mul[a][j] = gf_exp[gf_log[a] + gen_log[j]];
+}
+
 
 /*****************************************************************************
  * Reed-Solomon code
@@ -98,6 +120,7 @@ int nand_calculate_ecc_kw(struct nand_device *nand, const uint8_t *data, uint8_t
 
 	if (!tables_initialized) {
 		gf_build_log_exp_table();
+		gf_build_gen_mul_table();
 		tables_initialized = 1;
 	}
 
@@ -125,27 +148,17 @@ int nand_calculate_ecc_kw(struct nand_device *nand, const uint8_t *data, uint8_t
 		if (i >= 0)
 			d = data[i];
 
-		if (r7) {
-			uint16_t *t = gf_exp + gf_log[r7];
-
-			r7 = r6 ^ t[0x21c];
-			r6 = r5 ^ t[0x181];
-			r5 = r4 ^ t[0x18e];
-			r4 = r3 ^ t[0x25f];
-			r3 = r2 ^ t[0x197];
-			r2 = r1 ^ t[0x193];
-			r1 = r0 ^ t[0x237];
-			r0 = d  ^ t[0x024];
-		} else {
-			r7 = r6;
-			r6 = r5;
-			r5 = r4;
-			r4 = r3;
-			r3 = r2;
-			r2 = r1;
-			r1 = r0;
-			r0 = d;
-		}
+		/* gen_mul[0] is all zeroes, no need to test r7 */
+		const uint16_t *t = gen_mul[r7];
+
+		r7 = r6 ^ t[0];
+		r6 = r5 ^ t[1];
+		r5 = r4 ^ t[2];
+		r4 = r3 ^ t[3];
+		r3 = r2 ^ t[4];
+		r2 = r1 ^ t[5];
+		r1 = r0 ^ t[6];
+		r0 = d  ^ t[7];
 	}
 
 	ecc[0] = r0;
@@ -580,7 +580,6 @@ static int lpc32xx_write_page_mlc(struct nand_device *nand, uint32_t page,
 {
 	struct target *target = nand->target;
 	int retval;
-	uint8_t status;
 	static uint8_t page_buffer[512];
 	static uint8_t oob_buffer[6];
 	int quarter, num_quarters;
@@ -706,26 +705,8 @@ static int lpc32xx_write_page_mlc(struct nand_device *nand, uint32_t page,
 		}
 	}
 
-	/* MLC_CMD = auto program command */
-	retval = target_write_u32(target, 0x200b8000, NAND_CMD_PAGEPROG);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("could not set MLC_CMD");
-		return ERROR_NAND_OPERATION_FAILED;
-	}
-
-	retval = nand_read_status(nand, &status);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("couldn't read status");
-		return ERROR_NAND_OPERATION_FAILED;
-	}
-
-	if (status & NAND_STATUS_FAIL) {
-		LOG_ERROR("write operation didn't pass, status: 0x%2.2x",
-			status);
-		return ERROR_NAND_OPERATION_FAILED;
-	}
-
-	return ERROR_OK;
+	/* MLC_CMD = auto program command, or cache program within "nand write" */
+	return nand_write_finish(nand);
 }
 
 /* SLC controller in !raw mode will use target cpu to read/write nand from/to
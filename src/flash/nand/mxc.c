@@ -382,7 +382,8 @@ static int mxc_command(struct nand_device *nand, uint8_t command)
 			mxc_nf_info->optype = MXC_NF_DATAOUT_NANDSTATUS;
 			mxc_nf_info->fin = MXC_NF_FIN_DATAOUT;
 			target_write_u16 (target, MXC_NF_BUFADDR, 0);
-			in_sram_address = 0;
+			/* the status byte is output to the start of the main buffer */
+			in_sram_address = MXC_NF_MAIN_BUFFER0;
 			break;
 		case NAND_CMD_READ0:
 			mxc_nf_info->fin = MXC_NF_FIN_DATAOUT;
@@ -452,7 +453,6 @@ static int mxc_write_page(struct nand_device *nand, uint32_t page,
 	struct mxc_nf_controller *mxc_nf_info = nand->controller_priv;
 	struct target *target = nand->target;
 	int retval;
-	uint16_t nand_status_content;
 	uint16_t swap1, swap2, new_swap1;
 	uint8_t bufs;
 	int poll_result;
@@ -544,30 +544,16 @@ static int mxc_write_page(struct nand_device *nand, uint32_t page,
 			return poll_result;
 	}
 
-	retval |= mxc_command(nand, NAND_CMD_PAGEPROG);
 	if (retval != ERROR_OK)
 		return retval;
 
 	/*
-	 * check status register
+	 * page program, or cache program within "nand write", and check
+	 * the status register
 	 */
-	retval = ERROR_OK;
-	retval |= mxc_command(nand, NAND_CMD_STATUS);
-	target_write_u16 (target, MXC_NF_BUFADDR, 0);
-	mxc_nf_info->optype = MXC_NF_DATAOUT_NANDSTATUS;
-	mxc_nf_info->fin = MXC_NF_FIN_DATAOUT;
-	retval |= do_data_output(nand);
-	if (retval != ERROR_OK) {
-		LOG_ERROR(get_status_register_err_msg);
+	retval = nand_write_finish(nand);
+	if (retval != ERROR_OK)
 		return retval;
-	}
-	target_read_u16(target, MXC_NF_MAIN_BUFFER0, &nand_status_content);
-	if (nand_status_content & 0x0001) {
-		/*
-		 * page not correctly written
-		 */
-		return ERROR_NAND_OPERATION_FAILED;
-	}
 #ifdef _MXC_PRINT_STAT
 	LOG_INFO("%d bytes newly written", data_size);
 #endif
@@ -226,6 +226,9 @@ COMMAND_HANDLER(handle_nand_check_bad_blocks_command)
 	return retval;
 }
 
+/* nand write hands this many pages at once to the NAND layer */
+#define NAND_WRITE_BATCH_PAGES	64
+
 COMMAND_HANDLER(handle_nand_write_command)
 {
 	struct nand_device *nand = NULL;
@@ -235,28 +238,61 @@ COMMAND_HANDLER(handle_nand_write_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* hand the pages to the NAND layer in batches, allocated once */
+	uint8_t *pages = NULL;
+	uint8_t *oobs = NULL;
+	if (s.page)
+		pages = malloc(NAND_WRITE_BATCH_PAGES * s.page_size);
+	if (s.oob)
+		oobs = malloc(NAND_WRITE_BATCH_PAGES * s.oob_size);
+	if ((s.page && !pages) || (s.oob && !oobs)) {
+		LOG_ERROR("Out of memory");
+		free(pages);
+		free(oobs);
+		nand_fileio_cleanup(&s);
+		return ERROR_FAIL;
+	}
+
 	uint32_t total_bytes = s.size;
 	while (s.size > 0) {
-		int bytes_read = nand_fileio_read(nand, &s);
-		if (bytes_read <= 0) {
-			command_print(CMD, "error while reading file");
-			nand_fileio_cleanup(&s);
-			return ERROR_FAIL;
+		uint32_t batch_address = s.address;
+		unsigned int count = 0;
+
+		while (s.size > 0 && count < NAND_WRITE_BATCH_PAGES) {
+			int bytes_read = nand_fileio_read(nand, &s);
+			if (bytes_read <= 0) {
+				command_print(CMD, "error while reading file");
+				free(pages);
+				free(oobs);
+				nand_fileio_cleanup(&s);
+				return ERROR_FAIL;
+			}
+			s.size -= bytes_read;
+
+			if (pages)
+				memcpy(pages + count * s.page_size, s.page, s.page_size);
+			if (oobs)
+				memcpy(oobs + count * s.oob_size, s.oob, s.oob_size);
+			count++;
+			s.address += s.page_size;
 		}
-		s.size -= bytes_read;
 
-		retval = nand_write_page(nand, s.address / nand->page_size,
-				s.page, s.page_size, s.oob, s.oob_size);
+		retval = nand_write_pages(nand, batch_address / nand->page_size, count,
+				pages, s.page_size, oobs, s.oob_size);
 		if (retval != ERROR_OK) {
 			command_print(CMD, "failed writing file %s "
 				"to NAND flash %s at offset 0x%8.8" PRIx32,
-				CMD_ARGV[1], CMD_ARGV[0], s.address);
+				CMD_ARGV[1], CMD_ARGV[0], batch_address);
+			free(pages);
+			free(oobs);
 			nand_fileio_cleanup(&s);
 			return retval;
 		}
-		s.address += s.page_size;
 	}
 
+	free(pages);
+	free(oobs);
+
 	if (nand_fileio_finish(&s) == ERROR_OK) {
 		command_print(CMD, "wrote file %s to NAND flash %s up to "
 			"offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
@@ -391,6 +427,37 @@ COMMAND_HANDLER(handle_nand_raw_access_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_nand_cache_program_command)
+{
+	if ((CMD_ARGC < 1) || (CMD_ARGC > 2))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct nand_device *p;
+	int retval = CALL_COMMAND_HANDLER(nand_command_get_device, 0, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (!p->device) {
+		command_print(CMD, "#%s: not probed", CMD_ARGV[0]);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC == 2) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[1], enable);
+		if (enable && !(p->device->options & NAND_CACHEPRG)) {
+			command_print(CMD, "#%s: device has no cache program function", CMD_ARGV[0]);
+			return ERROR_FAIL;
+		}
+		p->use_cache_program = enable;
+	}
+
+	const char *msg = p->use_cache_program ? "enabled" : "disabled";
+	command_print(CMD, "cache program is %s", msg);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration nand_exec_command_handlers[] = {
 	{
 		.name = "list",
@@ -458,6 +525,14 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.usage = "bank_id ['enable'|'disable']",
 		.help = "raw access to NAND flash device",
 	},
+	{
+		.name = "cache_program",
+		.handler = handle_nand_cache_program_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['enable'|'disable']",
+		.help = "program consecutive pages of NAND flash device with "
+			"the cache program command",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -534,6 +609,9 @@ static COMMAND_HELPER(create_nand_device, const char *bank_name,
 	c->address_cycles = 0;
 	c->page_size = 0;
 	c->use_raw = false;
+	c->use_cache_program = false;
+	c->cache_program_more = false;
+	c->cache_program_active = false;
 	c->next = NULL;
 
 	retval = CALL_COMMAND_HANDLER(controller->nand_device_command, c);
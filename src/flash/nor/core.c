@@ -16,6 +16,8 @@
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
 #include <target/image.h>
+#include <helper/metrics.h>
+#include <helper/time_support.h>
 
 /**
  * @file
@@ -85,8 +87,10 @@ int flash_driver_protect(struct flash_bank *bank, int set, unsigned int first,
 int flash_driver_write(struct flash_bank *bank,
 	const uint8_t *buffer, uint32_t offset, uint32_t count)
 {
+	struct duration write_time;
 	int retval;
 
+	duration_start(&write_time);
 	retval = bank->driver->write(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
@@ -94,6 +98,18 @@ int flash_driver_write(struct flash_bank *bank,
 			" at offset 0x%8.8" PRIx32,
 			bank->base,
 			offset);
+		return retval;
+	}
+
+	if (metrics_enabled && duration_measure(&write_time) == ERROR_OK) {
+		char labels[64];
+
+		snprintf(labels, sizeof(labels), "driver=\"%s\"", bank->driver->name);
+		metrics_add(METRICS_FLASH_WRITE_BYTES, labels, count);
+		metrics_observe(METRICS_FLASH_WRITE_SECONDS, labels, &write_time);
+		/* too short to measure, the rate would be infinite */
+		if (duration_elapsed(&write_time) > 0)
+			metrics_set(METRICS_FLASH_WRITE_RATE, labels, duration_kbps(&write_time, count) * 1024);
 	}
 
 	return retval;
@@ -727,6 +743,341 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
+/* Check whether a part of the bank already holds the given data, by a
+ * checksum computed on the target. That needs the driver to verify or the
+ * bank to be memory mapped; without it, the range is taken as changed. */
+static bool flash_range_crc_unchanged(struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	if (bank->driver->verify)
+		return bank->driver->verify(bank, buffer, offset, count) == ERROR_OK;
+
+	if (bank->driver->read == default_flash_read)
+		return default_flash_verify(bank, buffer, offset, count) == ERROR_OK;
+
+	return false;
+}
+
+static int flash_write_sector_run(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t count, bool unlock)
+{
+	int retval = ERROR_OK;
+
+	if (unlock)
+		retval = flash_unlock_address_range(target, bank->base + offset, count);
+	if (retval == ERROR_OK)
+		retval = flash_erase_address_range(target, true, bank->base + offset, count);
+	if (retval == ERROR_OK)
+		retval = flash_driver_write(bank, buffer, offset, count);
+
+	return retval;
+}
+
+/* Erase and write only the sectors whose contents differ from the image,
+ * merging consecutive changed sectors into one erase and write. An image
+ * which is unchanged as a whole costs one checksum; otherwise the range is
+ * read back once and compared sector by sector. */
+static int flash_write_changed_sectors(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, target_addr_t address, uint32_t size, bool unlock)
+{
+	uint32_t offset = address - bank->base;
+	uint32_t end = offset + size;
+	uint32_t run_start = 0, run_end = 0;
+	uint32_t skipped = 0;
+	int retval;
+
+	if (flash_range_crc_unchanged(bank, buffer, offset, size)) {
+		LOG_INFO("Flash at " TARGET_ADDR_FMT " is unchanged, skipping %" PRIu32 " bytes",
+			address, size);
+		return ERROR_OK;
+	}
+
+	uint8_t *data = malloc(size);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = bank->driver->read(bank, data, offset, size);
+	if (retval != ERROR_OK) {
+		free(data);
+		return retval;
+	}
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		uint32_t start = MAX(offset, bank->sectors[i].offset);
+		uint32_t stop = MIN(end, bank->sectors[i].offset + bank->sectors[i].size);
+
+		if (start >= stop)
+			continue;
+
+		if (memcmp(data + start - offset, buffer + start - offset, stop - start)) {
+			if (run_start == run_end)
+				run_start = start;
+			run_end = stop;
+			continue;
+		}
+
+		skipped += stop - start;
+		if (run_start != run_end) {
+			retval = flash_write_sector_run(target, bank, buffer + run_start - offset,
+					run_start, run_end - run_start, unlock);
+			if (retval != ERROR_OK) {
+				free(data);
+				return retval;
+			}
+			run_start = run_end;
+		}
+	}
+	free(data);
+
+	if (run_start != run_end) {
+		retval = flash_write_sector_run(target, bank, buffer + run_start - offset,
+				run_start, run_end - run_start, unlock);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (skipped)
+		LOG_INFO("Skipped %" PRIu32 " bytes of unchanged flash sectors", skipped);
+
+	return ERROR_OK;
+}
+
+/* Sector erases on a bank whose driver can erase in the background */
+struct flash_erase_queue {
+	struct flash_bank *bank;
+	bool *pending;		/* sectors still to be erased */
+	unsigned int sector;	/* sector being erased */
+	bool busy;		/* an erase is in progress */
+};
+
+/* A run of the image waiting for the erase of its bank */
+struct flash_write_job {
+	struct flash_erase_queue *queue;
+	uint8_t *buffer;
+	target_addr_t address;
+	uint32_t size;
+};
+
+/* Runs of "write_image erase" on banks with erase_start()/erase_poll().
+ * Their sectors are erased in the background, concurrently on all such
+ * banks, while runs of other banks are handled; each run is programmed
+ * once its bank is fully erased. */
+struct flash_write_sched {
+	struct flash_erase_queue *queues;
+	unsigned int num_queues;
+	struct flash_write_job *jobs;
+	unsigned int num_jobs;
+	unsigned int jobs_done;
+	uint32_t bytes;
+	int retval;		/* first erase error; no new erases are started after it */
+};
+
+static bool flash_can_erase_async(struct flash_bank *bank)
+{
+	return bank->driver->erase_start && bank->driver->erase_poll;
+}
+
+static struct flash_erase_queue *flash_sched_get_queue(struct flash_write_sched *sched,
+	struct flash_bank *bank)
+{
+	for (unsigned int i = 0; i < sched->num_queues; i++)
+		if (sched->queues[i].bank == bank)
+			return &sched->queues[i];
+
+	bool *pending = calloc(bank->num_sectors, sizeof(*pending));
+	if (!pending)
+		return NULL;
+
+	struct flash_erase_queue *queues = realloc(sched->queues,
+			(sched->num_queues + 1) * sizeof(*queues));
+	if (!queues) {
+		free(pending);
+		return NULL;
+	}
+
+	/* jobs point to their queue, follow the move */
+	for (unsigned int i = 0; i < sched->num_jobs; i++)
+		sched->jobs[i].queue = queues + (sched->jobs[i].queue - sched->queues);
+	sched->queues = queues;
+
+	struct flash_erase_queue *queue = &queues[sched->num_queues++];
+	queue->bank = bank;
+	queue->pending = pending;
+	queue->sector = 0;
+	queue->busy = false;
+
+	return queue;
+}
+
+/* Queue the erase of the sectors touched by a run, and the run itself.
+ * The scheduler takes ownership of the buffer. */
+static int flash_sched_add(struct flash_write_sched *sched, struct flash_bank *bank,
+	uint8_t *buffer, target_addr_t address, uint32_t size)
+{
+	struct flash_erase_queue *queue = flash_sched_get_queue(sched, bank);
+	struct flash_write_job *jobs = realloc(sched->jobs, (sched->num_jobs + 1) * sizeof(*jobs));
+	if (!queue || !jobs) {
+		LOG_ERROR("Out of memory");
+		if (jobs)
+			sched->jobs = jobs;
+		free(buffer);
+		return ERROR_FAIL;
+	}
+	sched->jobs = jobs;
+
+	uint32_t offset = address - bank->base;
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+
+		if (sector->offset >= offset + size || sector->offset + sector->size <= offset)
+			continue;
+
+		queue->pending[i] = true;
+	}
+
+	struct flash_write_job *job = &jobs[sched->num_jobs++];
+	job->queue = queue;
+	job->buffer = buffer;
+	job->address = address;
+	job->size = size;
+
+	return ERROR_OK;
+}
+
+/* Collect completed erases and start the next ones, without waiting.
+ * Returns true while any erase is in progress. */
+static bool flash_sched_erase_poll(struct flash_write_sched *sched)
+{
+	bool active = false;
+
+	for (unsigned int i = 0; i < sched->num_queues; i++) {
+		struct flash_erase_queue *queue = &sched->queues[i];
+		struct flash_bank *bank = queue->bank;
+		int retval;
+
+		if (queue->busy) {
+			retval = bank->driver->erase_poll(bank);
+			if (retval == ERROR_FLASH_BUSY) {
+				active = true;
+				continue;
+			}
+
+			queue->busy = false;
+			if (retval != ERROR_OK) {
+				LOG_ERROR("failed erasing sector %u of bank %s", queue->sector, bank->name);
+				if (sched->retval == ERROR_OK)
+					sched->retval = retval;
+			} else {
+				bank->sectors[queue->sector].is_erased = 1;
+			}
+		}
+
+		if (sched->retval != ERROR_OK)
+			continue;
+
+		unsigned int sector = 0;
+		while (sector < bank->num_sectors && !queue->pending[sector])
+			sector++;
+		if (sector == bank->num_sectors)
+			continue;
+
+		queue->pending[sector] = false;
+		queue->sector = sector;
+		retval = bank->driver->erase_start(bank, sector);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("failed erasing sector %u of bank %s", sector, bank->name);
+			sched->retval = retval;
+			continue;
+		}
+		queue->busy = true;
+		active = true;
+	}
+
+	return active;
+}
+
+static bool flash_sched_bank_erased(struct flash_erase_queue *queue)
+{
+	if (queue->busy)
+		return false;
+
+	for (unsigned int i = 0; i < queue->bank->num_sectors; i++)
+		if (queue->pending[i])
+			return false;
+
+	return true;
+}
+
+/* Program and optionally verify one run whose bank is erased, if any.
+ * Returns true when a run was handled. */
+static bool flash_sched_write_one(struct flash_write_sched *sched, bool verify, int *retval)
+{
+	for (unsigned int i = 0; i < sched->num_jobs; i++) {
+		struct flash_write_job *job = &sched->jobs[i];
+
+		if (!job->buffer || !flash_sched_bank_erased(job->queue))
+			continue;
+
+		struct flash_bank *bank = job->queue->bank;
+		uint32_t offset = job->address - bank->base;
+
+		*retval = flash_driver_write(bank, job->buffer, offset, job->size);
+		if (*retval == ERROR_OK && verify)
+			*retval = flash_driver_verify(bank, job->buffer, offset, job->size);
+
+		free(job->buffer);
+		job->buffer = NULL;
+		sched->jobs_done++;
+		if (*retval == ERROR_OK)
+			sched->bytes += job->size;
+
+		return true;
+	}
+
+	return false;
+}
+
+/* Complete all queued erases and runs */
+static int flash_sched_run(struct flash_write_sched *sched, bool verify)
+{
+	int retval = ERROR_OK;
+
+	while (sched->jobs_done < sched->num_jobs) {
+		bool active = flash_sched_erase_poll(sched);
+		if (sched->retval != ERROR_OK) {
+			retval = sched->retval;
+			break;
+		}
+
+		if (!flash_sched_write_one(sched, verify, &retval) && active)
+			alive_sleep(1);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	/* after an error, let the erases in progress complete */
+	if (retval != ERROR_OK) {
+		if (sched->retval == ERROR_OK)
+			sched->retval = retval;
+		while (flash_sched_erase_poll(sched))
+			alive_sleep(1);
+	}
+
+	return retval;
+}
+
+static void flash_sched_free(struct flash_write_sched *sched)
+{
+	for (unsigned int i = 0; i < sched->num_jobs; i++)
+		free(sched->jobs[i].buffer);
+	for (unsigned int i = 0; i < sched->num_queues; i++)
+		free(sched->queues[i].pending);
+	free(sched->jobs);
+	free(sched->queues);
+}
+
 int flash_write_unlock_verify(struct target *target, struct image *image,
 	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
 {
@@ -736,9 +1087,12 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	uint32_t section_offset;
 	struct flash_bank *c;
 	int *padding;
+	struct flash_write_sched sched = { 0 };
+	struct duration write_time;
 
 	section = 0;
 	section_offset = 0;
+	duration_start(&write_time);
 
 	if (written)
 		*written = 0;
@@ -951,20 +1305,41 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 
 		retval = ERROR_OK;
 
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
+		if (erase && write && !c->skip_unchanged && flash_can_erase_async(c)) {
+			/* erase in the background, program when the bank is erased */
+			if (unlock)
+				retval = flash_unlock_address_range(target, run_address, run_size);
+			if (retval == ERROR_OK)
+				retval = flash_sched_add(&sched, c, buffer, run_address, run_size);
+			else
+				free(buffer);
+			if (retval != ERROR_OK)
+				goto done;
+
+			flash_sched_erase_poll(&sched);
+			continue;
 		}
 
-		if (retval == ERROR_OK) {
-			if (write) {
-				/* write flash sectors */
-				retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+		if (c->skip_unchanged && erase && write) {
+			/* only erase and write the sectors which differ */
+			retval = flash_write_changed_sectors(target, c, buffer,
+					run_address, run_size, unlock);
+		} else {
+			if (unlock)
+				retval = flash_unlock_address_range(target, run_address, run_size);
+			if (retval == ERROR_OK) {
+				if (erase) {
+					/* calculate and erase sectors */
+					retval = flash_erase_address_range(target,
+							true, run_address, run_size);
+				}
+			}
+
+			if (retval == ERROR_OK) {
+				if (write) {
+					/* write flash sectors */
+					retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+				}
 			}
 		}
 
@@ -984,9 +1359,31 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 
 		if (written)
 			*written += run_size;	/* add run size to total written counter */
+
+		/* keep the background erases going */
+		flash_sched_erase_poll(&sched);
+	}
+
+	if (sched.num_jobs) {
+		retval = flash_sched_run(&sched, verify);
+		if (written)
+			*written += sched.bytes;
+
+		if (retval == ERROR_OK && duration_measure(&write_time) == ERROR_OK)
+			LOG_INFO("erased and programmed %" PRIu32 " bytes in %u banks "
+				"in %fs (%0.3f KiB/s)", sched.bytes, sched.num_queues,
+				duration_elapsed(&write_time), duration_kbps(&write_time, sched.bytes));
 	}
 
 done:
+	/* an error in the image loop leaves background erases running */
+	if (retval != ERROR_OK && sched.jobs_done < sched.num_jobs) {
+		if (sched.retval == ERROR_OK)
+			sched.retval = retval;
+		while (flash_sched_erase_poll(&sched))
+			alive_sleep(1);
+	}
+	flash_sched_free(&sched);
 	free(sections);
 	free(padding);
 
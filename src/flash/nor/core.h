@@ -105,6 +105,10 @@ struct flash_bank {
 	 * sectors in between.
      * Can be size in bytes or FLASH_WRITE_CONTINUOUS */
 	uint32_t minimal_write_gap;
+	/** Compare each sector with the image before "write_image erase"
+	 * and leave the sectors which already hold the right data alone.
+	 * Off by default, set by the "flash skip_unchanged" command. */
+	bool skip_unchanged;
 
 	/**
 	 * The number of sectors on this chip.  This value will
@@ -96,6 +96,29 @@ struct flash_driver {
 	int (*erase)(struct flash_bank *bank, unsigned int first,
 		unsigned int last);
 
+	/**
+	 * Start erasing one sector and return without waiting for the
+	 * erase to complete (optional). Banks with their own flash
+	 * controller provide this together with erase_poll(), so that
+	 * "flash write_image erase" can erase several banks at once and
+	 * program one bank while another one is still erasing.
+	 *
+	 * @param bank The bank of flash to be erased.
+	 * @param sector The number of the sector to erase.
+	 * @returns ERROR_OK if the erase was started; otherwise, an error code.
+	 */
+	int (*erase_start)(struct flash_bank *bank, unsigned int sector);
+
+	/**
+	 * Check the erase started by erase_start(). The driver is
+	 * responsible for the erase time-out.
+	 *
+	 * @param bank The bank of flash being erased.
+	 * @returns ERROR_FLASH_BUSY while the erase is in progress, ERROR_OK
+	 * once it completed successfully; otherwise, an error code.
+	 */
+	int (*erase_poll)(struct flash_bank *bank);
+
 	/**
 	 * Bank/sector protection routine (target-specific).
 	 *
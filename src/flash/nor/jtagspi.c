@@ -9,12 +9,21 @@
 #endif
 
 #include "imp.h"
+#include <jtag/adapter.h>
 #include <jtag/jtag.h>
 #include <flash/nor/spi.h>
 #include <helper/time_support.h>
 #include <pld/pld.h>
 
 #define JTAGSPI_MAX_TIMEOUT 3000
+/* pages programmed in one queue by the queued write */
+#define JTAGSPI_WRITE_BATCH_PAGES 64
+/* initial and maximum delay between page program and status check, in us */
+#define JTAGSPI_PAGE_PROG_US 1000
+#define JTAGSPI_MAX_PAGE_PROG_US 10000
+/* reads are split at this boundary and issued in batches of chunks per queue */
+#define JTAGSPI_READ_CHUNK 0x10000
+#define JTAGSPI_READ_BATCH 16
 
 
 struct jtagspi_flash_bank {
@@ -27,6 +36,8 @@ struct jtagspi_flash_bank {
 	struct pld_device *pld_device; /* if not NULL, the PLD has special instructions for JTAGSPI */
 	uint32_t ir;                   /* when !pld_device, this instruction code is used in
 									  jtagspi_set_user_ir to connect through a proxy bitstream */
+	bool queued_write;             /* program many pages per JTAG queue */
+	unsigned int page_prog_us;     /* delay before the status check of a queued page program */
 };
 
 FLASH_BANK_COMMAND_HANDLER(jtagspi_flash_bank_command)
@@ -73,6 +84,8 @@ FLASH_BANK_COMMAND_HANDLER(jtagspi_flash_bank_command)
 	}
 	info->tap = bank->target->tap;
 	info->probed = false;
+	info->queued_write = true;
+	info->page_prog_us = JTAGSPI_PAGE_PROG_US;
 
 	info->ir = ir;
 	info->pld_device = device;
@@ -93,14 +106,11 @@ static void jtagspi_set_user_ir(struct jtagspi_flash_bank *info)
 	jtag_add_ir_scan(info->tap, &field, TAP_IDLE);
 }
 
-static void flip_u8(const uint8_t *in, uint8_t *out, unsigned int len)
-{
-	for (unsigned int i = 0; i < len; i++)
-		out[i] = flip_u32(in[i], 8);
-}
-
-static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
-		uint8_t *write_buffer, unsigned int write_len, uint8_t *data_buffer, int data_len)
+/* Queue one SPI command. Negative data_len means read; the data read stays bit
+ * reversed until the caller flips it after executing the queue.
+ * Written data is copied into the queue, the caller's buffers are left alone. */
+static int jtagspi_queue_cmd(struct flash_bank *bank, uint8_t cmd,
+		const uint8_t *write_buffer, unsigned int write_len, uint8_t *data_buffer, int data_len)
 {
 	assert(write_buffer || write_len == 0);
 	assert(data_buffer || data_len == 0);
@@ -124,6 +134,13 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 			return retval;
 	}
 
+	/* bit reversed copy of the address and written data */
+	uint8_t *out = malloc(write_len + (is_read ? 0 : data_len) + 1);
+	if (!out) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
 	int n = 0;
 	const uint8_t marker = 1;
 	uint8_t xfer_bits[4];
@@ -137,23 +154,23 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 		/* transfer length = cmd + address + read/write,
 		 * -1 due to the counter implementation */
 		h_u32_to_be(xfer_bits, ((sizeof(cmd) + write_len + data_len) * CHAR_BIT) - 1);
-		flip_u8(xfer_bits, xfer_bits, sizeof(xfer_bits));
+		buf_flip_u8(xfer_bits, xfer_bits, sizeof(xfer_bits));
 		fields[n].num_bits = sizeof(xfer_bits) * CHAR_BIT;
 		fields[n].out_value = xfer_bits;
 		fields[n].in_value = NULL;
 		n++;
 	}
 
-	flip_u8(&cmd, &cmd, sizeof(cmd));
+	buf_flip_u8(&cmd, &cmd, sizeof(cmd));
 	fields[n].num_bits = sizeof(cmd) * CHAR_BIT;
 	fields[n].out_value = &cmd;
 	fields[n].in_value = NULL;
 	n++;
 
 	if (write_len) {
-		flip_u8(write_buffer, write_buffer, write_len);
+		buf_flip_u8(write_buffer, out, write_len);
 		fields[n].num_bits = write_len * CHAR_BIT;
-		fields[n].out_value = write_buffer;
+		fields[n].out_value = out;
 		fields[n].in_value = NULL;
 		n++;
 	}
@@ -170,8 +187,8 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 			fields[n].out_value = NULL;
 			fields[n].in_value = data_buffer;
 		} else {
-			flip_u8(data_buffer, data_buffer, data_len);
-			fields[n].out_value = data_buffer;
+			buf_flip_u8(data_buffer, out + write_len, data_len);
+			fields[n].out_value = out + write_len;
 			fields[n].in_value = NULL;
 		}
 		fields[n].num_bits = data_len * CHAR_BIT;
@@ -184,28 +201,58 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 		n++;
 	}
 
-	if (info->pld_device) {
-		int retval = pld_connect_spi_to_jtag(info->pld_device);
-		if (retval != ERROR_OK)
-			return retval;
-	} else {
+	if (!info->pld_device)
 		jtagspi_set_user_ir(info);
-	}
 
 	/* passing from an IR scan to SHIFT-DR clears BYPASS registers */
 	jtag_add_dr_scan(info->tap, n, fields, TAP_IDLE);
-	int retval = jtag_execute_queue();
-	if (retval != ERROR_OK)
-		return retval;
 
-	if (is_read)
-		flip_u8(data_buffer, data_buffer, data_len);
+	/* the scan copied the out values */
+	free(out);
+
+	return ERROR_OK;
+}
+
+static int jtagspi_connect(struct flash_bank *bank)
+{
+	struct jtagspi_flash_bank *info = bank->driver_priv;
+
+	if (info->pld_device)
+		return pld_connect_spi_to_jtag(info->pld_device);
+	return ERROR_OK;
+}
+
+static int jtagspi_disconnect(struct flash_bank *bank)
+{
+	struct jtagspi_flash_bank *info = bank->driver_priv;
 
 	if (info->pld_device)
 		return pld_disconnect_spi_from_jtag(info->pld_device);
 	return ERROR_OK;
 }
 
+static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
+		uint8_t *write_buffer, unsigned int write_len, uint8_t *data_buffer, int data_len)
+{
+	int retval = jtagspi_connect(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = jtagspi_queue_cmd(bank, cmd, write_buffer, write_len, data_buffer, data_len);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = jtag_execute_queue();
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* negative data_len == read operation */
+	if (data_len < 0)
+		buf_flip_u8(data_buffer, data_buffer, -data_len);
+
+	return jtagspi_disconnect(bank);
+}
+
 COMMAND_HANDLER(jtagspi_handle_set)
 {
 	struct flash_bank *bank = NULL;
@@ -433,6 +480,31 @@ COMMAND_HANDLER(jtagspi_handle_always_4byte)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtagspi_handle_queued_write)
+{
+	struct flash_bank *bank;
+	struct jtagspi_flash_bank *jtagspi_info;
+	int retval;
+
+	LOG_DEBUG("%s", __func__);
+
+	if ((CMD_ARGC != 1) && (CMD_ARGC != 2))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &bank);
+	if (ERROR_OK != retval)
+		return retval;
+
+	jtagspi_info = bank->driver_priv;
+
+	if (CMD_ARGC == 1)
+		command_print(CMD, jtagspi_info->queued_write ? "on" : "off");
+	else
+		COMMAND_PARSE_BOOL(CMD_ARGV[1], jtagspi_info->queued_write, "on", "off");
+
+	return ERROR_OK;
+}
+
 static int jtagspi_probe(struct flash_bank *bank)
 {
 	struct jtagspi_flash_bank *info = bank->driver_priv;
@@ -682,7 +754,6 @@ static int jtagspi_protect(struct flash_bank *bank, int set, unsigned int first,
 static int jtagspi_read(struct flash_bank *bank, uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	struct jtagspi_flash_bank *info = bank->driver_priv;
-	uint32_t pagesize, currsize;
 	uint8_t addr[sizeof(uint32_t)];
 	int retval;
 
@@ -691,31 +762,45 @@ static int jtagspi_read(struct flash_bank *bank, uint8_t *buffer, uint32_t offse
 		return ERROR_FLASH_BANK_NOT_PROBED;
 	}
 
-	/* if no sectorsize, use reasonable default */
-	pagesize = info->dev.sectorsize ? info->dev.sectorsize : info->dev.pagesize;
-	if (pagesize == 0)
-		pagesize = (info->dev.size_in_bytes <= SPIFLASH_DEF_PAGESIZE) ?
-			info->dev.size_in_bytes : SPIFLASH_DEF_PAGESIZE;
-
 	/* ATXP032/064/128 use always 4-byte addresses except for 0x03 read */
 	unsigned int addr_len = ((info->dev.read_cmd != 0x03) && info->always_4byte) ? 4 : info->addr_len;
 
+	/* read sequentially over many pages, several reads per queue */
 	while (count > 0) {
-		/* length up to end of current page */
-		currsize = ((offset + pagesize) & ~(pagesize - 1)) - offset;
-		/* but no more than remaining size */
-		currsize = (count < currsize) ? count : currsize;
+		uint8_t *batch_buffer = buffer;
+		uint32_t batch_size = 0;
+
+		retval = jtagspi_connect(bank);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (unsigned int i = 0; i < JTAGSPI_READ_BATCH && count > 0; i++) {
+			/* length up to end of current chunk */
+			uint32_t currsize = ((offset + JTAGSPI_READ_CHUNK) & ~(JTAGSPI_READ_CHUNK - 1)) - offset;
+			/* but no more than remaining size */
+			currsize = MIN(count, currsize);
+
+			retval = jtagspi_queue_cmd(bank, info->dev.read_cmd, fill_addr(offset, addr_len, addr),
+				addr_len, buffer, -currsize);
+			if (retval != ERROR_OK)
+				return retval;
+			LOG_DEBUG("read 0x%" PRIx32 " bytes at 0x%08" PRIx32, currsize, offset);
+			offset += currsize;
+			buffer += currsize;
+			count -= currsize;
+			batch_size += currsize;
+		}
 
-		retval = jtagspi_cmd(bank, info->dev.read_cmd, fill_addr(offset, addr_len, addr),
-			addr_len, buffer, -currsize);
+		retval = jtag_execute_queue();
 		if (retval != ERROR_OK) {
 			LOG_ERROR("page read error");
 			return retval;
 		}
-		LOG_DEBUG("read page at 0x%08" PRIx32, offset);
-		offset += currsize;
-		buffer += currsize;
-		count -= currsize;
+		buf_flip_u8(batch_buffer, batch_buffer, batch_size);
+
+		retval = jtagspi_disconnect(bank);
+		if (retval != ERROR_OK)
+			return retval;
 	}
 	return ERROR_OK;
 }
@@ -740,6 +825,129 @@ static int jtagspi_page_write(struct flash_bank *bank, const uint8_t *buffer, ui
 	return jtagspi_wait(bank, JTAGSPI_MAX_TIMEOUT);
 }
 
+static void jtagspi_queue_delay(unsigned int us)
+{
+	unsigned int khz = adapter_get_speed_khz();
+
+	/* idle clocks keep the delay inside the adapter's queue */
+	if (khz)
+		jtag_add_runtest(DIV_ROUND_UP(us * khz, 1000), TAP_IDLE);
+	else
+		jtag_add_sleep(us);
+}
+
+/* The status read right after a write enable shows whether the flash took
+ * it: idle with WEL set. A write enable sent while the previous page program
+ * was running is ignored, the status then shows BSY, or WEL clear if the
+ * program completed in between. */
+static bool jtagspi_wren_accepted(uint8_t status)
+{
+	return !(status & SPIFLASH_BSY_BIT) && (status & SPIFLASH_WE_BIT);
+}
+
+/* Program up to JTAGSPI_WRITE_BATCH_PAGES pages in one queue: write enable,
+ * status read, page program, a delay and another status read for each page.
+ * The status results are checked afterwards. A page program still running
+ * when the next write enable arrives makes the flash ignore that write enable
+ * and the following page program. Only these pages are programmed again, one
+ * by one: the others must not be programmed twice. */
+static int jtagspi_queued_write(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count, uint32_t pagesize)
+{
+	struct jtagspi_flash_bank *info = bank->driver_priv;
+	uint8_t addr[sizeof(uint32_t)];
+	uint8_t wren_status[JTAGSPI_WRITE_BATCH_PAGES];
+	uint8_t pp_status[JTAGSPI_WRITE_BATCH_PAGES];
+	uint32_t sizes[JTAGSPI_WRITE_BATCH_PAGES];
+	int retval;
+
+	/* ATXP032/064/128 use always 4-byte addresses except for 0x03 read */
+	unsigned int addr_len = ((info->dev.read_cmd != 0x03) && info->always_4byte) ? 4 : info->addr_len;
+
+	while (count > 0) {
+		const uint8_t *p = buffer;
+		uint32_t page_offset = offset;
+		uint32_t left = count;
+		unsigned int pages;
+
+		retval = jtagspi_connect(bank);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (pages = 0; pages < JTAGSPI_WRITE_BATCH_PAGES && left > 0; pages++) {
+			/* length up to end of current page */
+			uint32_t currsize = ((page_offset + pagesize) & ~(pagesize - 1)) - page_offset;
+			/* but no more than remaining size */
+			currsize = MIN(left, currsize);
+
+			retval = jtagspi_queue_cmd(bank, SPIFLASH_WRITE_ENABLE, NULL, 0, NULL, 0);
+			if (retval == ERROR_OK)
+				retval = jtagspi_queue_cmd(bank, SPIFLASH_READ_STATUS, NULL, 0,
+					&wren_status[pages], -1);
+			if (retval == ERROR_OK)
+				retval = jtagspi_queue_cmd(bank, info->dev.pprog_cmd,
+					fill_addr(page_offset, addr_len, addr), addr_len, (uint8_t *)p, currsize);
+			if (retval != ERROR_OK)
+				return retval;
+			jtagspi_queue_delay(info->page_prog_us);
+			retval = jtagspi_queue_cmd(bank, SPIFLASH_READ_STATUS, NULL, 0, &pp_status[pages], -1);
+			if (retval != ERROR_OK)
+				return retval;
+
+			sizes[pages] = currsize;
+			page_offset += currsize;
+			p += currsize;
+			left -= currsize;
+		}
+
+		retval = jtag_execute_queue();
+		if (retval != ERROR_OK)
+			return retval;
+
+		buf_flip_u8(wren_status, wren_status, pages);
+		buf_flip_u8(pp_status, pp_status, pages);
+
+		retval = jtagspi_disconnect(bank);
+		if (retval != ERROR_OK)
+			return retval;
+
+		bool missed = false;
+		for (unsigned int i = 0; i < pages; i++)
+			if (!jtagspi_wren_accepted(wren_status[i]))
+				missed = true;
+
+		if (missed) {
+			/* give the next pages more time */
+			info->page_prog_us = MIN(info->page_prog_us + info->page_prog_us / 2,
+				JTAGSPI_MAX_PAGE_PROG_US);
+			LOG_DEBUG("page program delay now %u us", info->page_prog_us);
+		}
+
+		if (pp_status[pages - 1] & SPIFLASH_BSY_BIT) {
+			retval = jtagspi_wait(bank, JTAGSPI_MAX_TIMEOUT);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		for (unsigned int i = 0; i < pages; i++) {
+			/* a write enable refused by the flash itself fails here */
+			if (!jtagspi_wren_accepted(wren_status[i])) {
+				LOG_DEBUG("page at 0x%08" PRIx32 " was skipped, programming it again", offset);
+				retval = jtagspi_page_write(bank, buffer, offset, sizes[i]);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+
+			LOG_DEBUG("wrote page at 0x%08" PRIx32, offset);
+			offset += sizes[i];
+			buffer += sizes[i];
+			count -= sizes[i];
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int jtagspi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	struct jtagspi_flash_bank *info = bank->driver_priv;
@@ -754,6 +962,9 @@ static int jtagspi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_
 	/* if no write pagesize, use reasonable default */
 	pagesize = info->dev.pagesize ? info->dev.pagesize : SPIFLASH_DEF_PAGESIZE;
 
+	if (info->queued_write)
+		return jtagspi_queued_write(bank, buffer, offset, count, pagesize);
+
 	while (count > 0) {
 		/* length up to end of current page */
 		currsize = ((offset + pagesize) & ~(pagesize - 1)) - offset;
@@ -823,6 +1034,13 @@ static const struct command_registration jtagspi_exec_command_handlers[] = {
 		.usage = "bank_id [ on | off ]",
 		.help = "Use always 4-byte address except for basic 0x03.",
 	},
+	{
+		.name = "queued_write",
+		.handler = jtagspi_handle_queued_write,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [ on | off ]",
+		.help = "Program many pages per JTAG queue, checking the status afterwards.",
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
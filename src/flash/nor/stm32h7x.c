@@ -9,6 +9,7 @@
 
 #include "imp.h"
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 #include <target/algorithm.h>
 #include <target/cortex_m.h>
 
@@ -125,6 +126,7 @@ struct stm32h7x_flash_bank {
 	uint32_t user_bank_size;
 	uint32_t flash_regs_base;    /* Address of flash reg controller */
 	const struct stm32h7x_part_info *part_info;
+	int64_t erase_start_ms;      /* Start of the erase started by stm32x_erase_start() */
 };
 
 enum stm32h7x_opt_rdp {
@@ -260,6 +262,26 @@ static inline int stm32x_get_flash_status(struct flash_bank *bank, uint32_t *sta
 	return stm32x_read_flash_reg(bank, FLASH_SR, status);
 }
 
+/* Report and clear the error flags left by a completed flash operation */
+static int stm32x_flash_op_result(struct flash_bank *bank, uint32_t status)
+{
+	int retval = ERROR_OK;
+
+	if (status & FLASH_WRPERR) {
+		LOG_ERROR("wait_flash_op_queue, WRPERR detected");
+		retval = ERROR_FAIL;
+	}
+
+	/* Clear error + EOP flags but report errors */
+	if (status & FLASH_ERROR) {
+		if (retval == ERROR_OK)
+			retval = ERROR_FAIL;
+		/* If this operation fails, we ignore it and report the original retval */
+		stm32x_write_flash_reg(bank, FLASH_CCR, status);
+	}
+	return retval;
+}
+
 static int stm32x_wait_flash_op_queue(struct flash_bank *bank, int timeout)
 {
 	uint32_t status;
@@ -281,19 +303,7 @@ static int stm32x_wait_flash_op_queue(struct flash_bank *bank, int timeout)
 		alive_sleep(1);
 	}
 
-	if (status & FLASH_WRPERR) {
-		LOG_ERROR("wait_flash_op_queue, WRPERR detected");
-		retval = ERROR_FAIL;
-	}
-
-	/* Clear error + EOP flags but report errors */
-	if (status & FLASH_ERROR) {
-		if (retval == ERROR_OK)
-			retval = ERROR_FAIL;
-		/* If this operation fails, we ignore it and report the original retval */
-		stm32x_write_flash_reg(bank, FLASH_CCR, status);
-	}
-	return retval;
+	return stm32x_flash_op_result(bank, status);
 }
 
 static int stm32x_unlock_reg(struct flash_bank *bank)
@@ -516,6 +526,62 @@ flash_lock:
 	return (retval == ERROR_OK) ? retval2 : retval;
 }
 
+/* Each bank has its own FLASH_CR/FLASH_SR, so the flash core may erase
+ * a sector of one bank while it erases or programs the other one */
+static int stm32x_erase_start(struct flash_bank *bank, unsigned int sector)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+	int retval;
+
+	assert(sector < bank->num_sectors);
+
+	if (bank->target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	retval = stm32x_unlock_reg(bank);
+	if (retval == ERROR_OK)
+		retval = stm32x_write_flash_reg(bank, FLASH_CR,
+				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64, sector));
+	if (retval == ERROR_OK)
+		retval = stm32x_write_flash_reg(bank, FLASH_CR,
+				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64 | FLASH_START, sector));
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error erase sector %u", sector);
+		stm32x_lock_reg(bank);
+		return retval;
+	}
+
+	LOG_DEBUG("erase sector %u started", sector);
+	stm32x_info->erase_start_ms = timeval_ms();
+
+	return ERROR_OK;
+}
+
+static int stm32x_erase_poll(struct flash_bank *bank)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+	uint32_t status;
+	int retval, retval2;
+
+	retval = stm32x_get_flash_status(bank, &status);
+	if (retval == ERROR_OK && (status & FLASH_QW)) {
+		if (timeval_ms() - stm32x_info->erase_start_ms <= FLASH_ERASE_TIMEOUT)
+			return ERROR_FLASH_BUSY;
+
+		LOG_ERROR("erase time-out, status: 0x%" PRIx32, status);
+		retval = ERROR_FAIL;
+	}
+
+	if (retval == ERROR_OK)
+		retval = stm32x_flash_op_result(bank, status);
+
+	retval2 = stm32x_lock_reg(bank);
+	if (retval2 != ERROR_OK)
+		LOG_ERROR("error during the lock of flash");
+
+	return (retval == ERROR_OK) ? retval2 : retval;
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, unsigned int first,
 		unsigned int last)
 {
@@ -1195,6 +1261,8 @@ const struct flash_driver stm32h7x_flash = {
 	.commands = stm32h7x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.erase_start = stm32x_erase_start,
+	.erase_poll = stm32x_erase_poll,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
 	.read = default_flash_read,
@@ -11,6 +11,7 @@
 #include "config.h"
 #endif
 #include "imp.h"
+#include <helper/crc32.h>
 #include <helper/time_support.h>
 #include <target/image.h>
 
@@ -843,13 +844,24 @@ COMMAND_HANDLER(handle_flash_write_bank_command)
 	return retval;
 }
 
+/* flash read_bank reads the bank in chunks of this size */
+#define FLASH_READ_BANK_CHUNK_SIZE	(64 * 1024)
+
 COMMAND_HANDLER(handle_flash_read_bank_command)
 {
 	uint32_t offset;
 	uint8_t *buffer;
 	struct fileio *fileio;
 	uint32_t length;
-	size_t written;
+	size_t written = 0;
+	bool do_crc = false;
+	uint32_t crc = 0xffffffff;
+
+	if (CMD_ARGC > 2 && strcmp(CMD_ARGV[0], "crc32") == 0) {
+		do_crc = true;
+		CMD_ARGV++;
+		CMD_ARGC--;
+	}
 
 	if (CMD_ARGC < 2 || CMD_ARGC > 4)
 		return ERROR_COMMAND_SYNTAX_ERROR;
@@ -885,19 +897,14 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return ERROR_COMMAND_ARGUMENT_INVALID;
 	}
 
-	buffer = malloc(length);
+	/* stream the bank to the file instead of holding all of it in memory */
+	uint32_t buf_size = MIN(length, FLASH_READ_BANK_CHUNK_SIZE);
+	buffer = malloc(buf_size ? buf_size : 1);
 	if (!buffer) {
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
 
-	retval = flash_driver_read(p, buffer, offset, length);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Read error");
-		free(buffer);
-		return retval;
-	}
-
 	retval = fileio_open(&fileio, CMD_ARGV[1], FILEIO_WRITE, FILEIO_BINARY);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Could not open file");
@@ -905,13 +912,38 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return retval;
 	}
 
-	retval = fileio_write(fileio, length, buffer, &written);
+	uint32_t pos = offset;
+	while (length > 0) {
+		uint32_t chunk = MIN(length, buf_size);
+		size_t chunk_written;
+
+		retval = flash_driver_read(p, buffer, pos, chunk);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Read error");
+			break;
+		}
+
+		retval = fileio_write(fileio, chunk, buffer, &chunk_written);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Could not write file");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		/* hash the chunk while it is at hand, saves a second pass */
+		if (do_crc)
+			crc = crc32_le(CRC32_POLY_LE, crc, buffer, chunk);
+
+		written += chunk_written;
+		pos += chunk;
+		length -= chunk;
+		keep_alive();
+	}
+
 	fileio_close(fileio);
 	free(buffer);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not write file");
-		return ERROR_FAIL;
-	}
+	if (retval != ERROR_OK)
+		return retval;
 
 	if (duration_measure(&bench) == ERROR_OK)
 		command_print(CMD, "wrote %zd bytes to file %s from flash bank %u"
@@ -919,6 +951,9 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 			written, CMD_ARGV[1], p->bank_number, offset,
 			duration_elapsed(&bench), duration_kbps(&bench, written));
 
+	if (do_crc)
+		command_print(CMD, "crc32 0x%08" PRIx32, ~crc);
+
 	return retval;
 }
 
@@ -1073,6 +1108,25 @@ COMMAND_HANDLER(handle_flash_padded_value_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_flash_skip_unchanged_command)
+{
+	if (CMD_ARGC != 1 && CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[1], p->skip_unchanged);
+
+	command_print(CMD, "Skipping unchanged sectors is %s for flash bank %u",
+			p->skip_unchanged ? "on" : "off", p->bank_number);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration flash_exec_command_handlers[] = {
 	{
 		.name = "probe",
@@ -1199,9 +1253,10 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "read_bank",
 		.handler = handle_flash_read_bank_command,
 		.mode = COMMAND_EXEC,
-		.usage = "bank_id filename [offset [length]]",
+		.usage = "['crc32'] bank_id filename [offset [length]]",
 		.help = "Read binary data from flash bank to file. Allow optional "
-			"offset from beginning of the bank (defaults to zero).",
+			"offset from beginning of the bank (defaults to zero). "
+			"Optionally print the CRC32 of the data read.",
 	},
 	{
 		.name = "verify_bank",
@@ -1229,6 +1284,14 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.usage = "bank_id value",
 		.help = "Set default flash padded value",
 	},
+	{
+		.name = "skip_unchanged",
+		.handler = handle_flash_skip_unchanged_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['on'|'off']",
+		.help = "Leave the sectors which already hold the image alone "
+			"on 'write_image erase'",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -175,6 +175,12 @@ uint32_t flip_u32(uint32_t value, unsigned int num)
 	return c;
 }
 
+void buf_flip_u8(const uint8_t *in, uint8_t *out, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		out[i] = bit_reverse_table256[in[i]];
+}
+
 static int ceil_f_to_u32(float x)
 {
 	if (x < 0)	/* return zero for negative numbers */
@@ -168,6 +168,14 @@ static inline uint64_t buf_get_u64(const uint8_t *_buffer,
  */
 uint32_t flip_u32(uint32_t value, unsigned width);
 
+/**
+ * Inverts the ordering of bits inside each byte of a buffer.
+ * @param in The bytes to flip.
+ * @param out Where to store the flipped bytes, may be the same as @c in.
+ * @param size The number of bytes.
+ */
+void buf_flip_u8(const uint8_t *in, uint8_t *out, size_t size);
+
 bool buf_cmp(const void *buf1, const void *buf2, unsigned size);
 bool buf_cmp_mask(const void *buf1, const void *buf2,
 		const void *mask, unsigned size);
@@ -22,6 +22,7 @@
 #include <server/gdb_server.h>
 #include <server/server.h>
 
+#include <signal.h>
 #include <stdarg.h>
 
 #ifdef _DEBUG_FREE_SPACE_
@@ -52,6 +53,152 @@ static const char * const log_strings[6] = {
 
 static int count;
 
+/* Log output which does not go to a terminal is collected in log_buffer and
+ * written out in large chunks: when the buffer fills up, when a warning or an
+ * error is logged, LOG_FLUSH_INTERVAL_MS after the last flush, whenever the
+ * server loop goes idle, on exit() and on fatal signals. Terminal output is
+ * still written line by line. */
+#define LOG_BUFFER_SIZE		(64 * 1024)
+#define LOG_FLUSH_INTERVAL_MS	100
+
+static char log_buffer[LOG_BUFFER_SIZE];
+static size_t log_buffer_len;
+static bool log_buffered;
+static int64_t log_last_flush;
+
+/* Fixed size records of the trace ring, stored little endian in dumps */
+#define LOG_TRACE_MAGIC			"OCDTRACE"
+#define LOG_TRACE_VERSION		1
+#define LOG_TRACE_HEADER_SIZE	16
+#define LOG_TRACE_RECORD_SIZE	20
+#define LOG_TRACE_DEFAULT_SIZE	4096
+/* minimum time between two dumps triggered by errors */
+#define LOG_TRACE_DUMP_INTERVAL_MS	1000
+
+struct log_trace_record {
+	uint64_t time_us;
+	uint32_t event;
+	uint32_t a;
+	uint32_t b;
+};
+
+static struct log_trace_record *log_trace_ring;
+/* number of records in the ring, a power of two */
+static unsigned int log_trace_size;
+/* number of records ever written to the ring */
+static uint64_t log_trace_count;
+static char *log_trace_error_file;
+static int64_t log_trace_last_dump;
+static bool log_trace_dumping;
+
+static int log_trace_dump(const char *file_name);
+
+static void log_set_output(FILE *file)
+{
+	log_flush();
+	log_output = file;
+	log_buffered = !isatty(fileno(file));
+	log_last_flush = timeval_ms();
+}
+
+void log_flush(void)
+{
+	if (!log_output)
+		return;
+
+	log_last_flush = timeval_ms();
+
+	if (!log_buffer_len)
+		return;
+
+	fwrite(log_buffer, 1, log_buffer_len, log_output);
+	log_buffer_len = 0;
+	fflush(log_output);
+}
+
+static void log_write(const char *format, ...)
+	__attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 1, 2)));
+
+static void log_write(const char *format, ...)
+{
+	va_list ap;
+
+	if (!log_buffered) {
+		va_start(ap, format);
+		vfprintf(log_output, format, ap);
+		va_end(ap);
+		return;
+	}
+
+	size_t avail = LOG_BUFFER_SIZE - log_buffer_len;
+	va_start(ap, format);
+	int len = vsnprintf(log_buffer + log_buffer_len, avail, format, ap);
+	va_end(ap);
+
+	if (len < 0)
+		return;
+
+	if ((size_t)len < avail) {
+		log_buffer_len += len;
+		return;
+	}
+
+	/* does not fit, make room; messages larger than the buffer go out directly */
+	log_flush();
+	va_start(ap, format);
+	if ((size_t)len < LOG_BUFFER_SIZE) {
+		vsnprintf(log_buffer, LOG_BUFFER_SIZE, format, ap);
+		log_buffer_len = len;
+	} else {
+		vfprintf(log_output, format, ap);
+	}
+	va_end(ap);
+}
+
+/* A crash must not lose the buffered log output leading to it. stdio is not
+ * async-signal-safe, so the buffer goes out with a plain write(). */
+static void log_fatal_signal(int sig)
+{
+	if (log_output && log_buffer_len) {
+		ssize_t written = write(fileno(log_output), log_buffer, log_buffer_len);
+		(void)written;
+	}
+
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+/* Flush at once what the user must see now, the rest in chunks */
+static void log_write_done(enum log_levels level)
+{
+	if (!log_buffered || level <= LOG_LVL_WARNING ||
+			timeval_ms() - log_last_flush >= LOG_FLUSH_INTERVAL_MS)
+		log_flush();
+}
+
+/* Record an error in the trace ring and dump the ring, if requested */
+static void log_trace_on_error(int line, const char *string)
+{
+	uint8_t head[4] = { 0 };
+
+	if (!log_trace_ring)
+		return;
+
+	for (unsigned int i = 0; i < sizeof(head) && string[i]; i++)
+		head[i] = string[i];
+	log_trace(LOG_TRACE_ERROR, line, le_to_h_u32(head));
+
+	if (!log_trace_error_file || log_trace_dumping)
+		return;
+
+	int64_t now = timeval_ms();
+	if (now - log_trace_last_dump < LOG_TRACE_DUMP_INTERVAL_MS)
+		return;
+	log_trace_last_dump = now;
+
+	log_trace_dump(log_trace_error_file);
+}
+
 /* forward the log to the listeners */
 static void log_forward(const char *file, unsigned line, const char *function, const char *string)
 {
@@ -92,8 +239,8 @@ static void log_puts(enum log_levels level,
 
 	if (level == LOG_LVL_OUTPUT) {
 		/* do not prepend any headers, just print out what we were given and return */
-		fputs(string, log_output);
-		fflush(log_output);
+		log_write("%s", string);
+		log_write_done(level);
 		return;
 	}
 
@@ -108,7 +255,7 @@ static void log_puts(enum log_levels level,
 		struct mallinfo info;
 		info = mallinfo();
 #endif
-		fprintf(log_output, "%s%d %" PRId64 " %s:%d %s()"
+		log_write("%s%d %" PRId64 " %s:%d %s()"
 #ifdef _DEBUG_FREE_SPACE_
 			" %d"
 #endif
@@ -120,11 +267,14 @@ static void log_puts(enum log_levels level,
 	} else {
 		/* if we are using gdb through pipes then we do not want any output
 		 * to the pipe otherwise we get repeated strings */
-		fprintf(log_output, "%s%s",
+		log_write("%s%s",
 			(level > LOG_LVL_USER) ? log_strings[level + 1] : "", string);
 	}
 
-	fflush(log_output);
+	log_write_done(level);
+
+	if (level == LOG_LVL_ERROR)
+		log_trace_on_error(line, string);
 
 	/* Never forward LOG_LVL_DEBUG, too verbose and they can be found in the log if need be */
 	if (level <= LOG_LVL_INFO)
@@ -230,14 +380,200 @@ COMMAND_HANDLER(handle_log_output_command)
 		command_print(CMD, "set log_output to default");
 	}
 
-	if (log_output != stderr && log_output) {
+	FILE *old_output = log_output;
+	log_set_output(file);
+	if (old_output != stderr && old_output) {
 		/* Close previous log file, if it was open and wasn't stderr. */
-		fclose(log_output);
+		fclose(old_output);
 	}
-	log_output = file;
 	return ERROR_OK;
 }
 
+static int log_trace_dump(const char *file_name)
+{
+	uint8_t header[LOG_TRACE_HEADER_SIZE];
+	uint8_t record[LOG_TRACE_RECORD_SIZE];
+	int retval = ERROR_OK;
+
+	if (!log_trace_ring) {
+		LOG_ERROR("trace ring is not enabled");
+		return ERROR_FAIL;
+	}
+
+	FILE *file = fopen(file_name, "wb");
+	if (!file) {
+		LOG_ERROR("failed to open trace dump \"%s\"", file_name);
+		return ERROR_FAIL;
+	}
+
+	/* keep errors reported while dumping out of the ring */
+	log_trace_dumping = true;
+
+	uint64_t first = 0;
+	if (log_trace_count > log_trace_size)
+		first = log_trace_count - log_trace_size;
+	uint32_t records = log_trace_count - first;
+
+	memcpy(header, LOG_TRACE_MAGIC, 8);
+	h_u32_to_le(header + 8, LOG_TRACE_VERSION);
+	h_u32_to_le(header + 12, records);
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+		retval = ERROR_FAIL;
+
+	/* oldest first */
+	for (uint64_t i = first; i < log_trace_count && retval == ERROR_OK; i++) {
+		const struct log_trace_record *r = &log_trace_ring[i & (log_trace_size - 1)];
+
+		h_u64_to_le(record, r->time_us);
+		h_u32_to_le(record + 8, r->event);
+		h_u32_to_le(record + 12, r->a);
+		h_u32_to_le(record + 16, r->b);
+		if (fwrite(record, 1, sizeof(record), file) != sizeof(record))
+			retval = ERROR_FAIL;
+	}
+
+	if (fclose(file) != 0)
+		retval = ERROR_FAIL;
+
+	if (retval != ERROR_OK)
+		LOG_ERROR("failed to write trace dump \"%s\"", file_name);
+	else
+		LOG_INFO("dumped %" PRIu32 " trace records to \"%s\"", records, file_name);
+
+	log_trace_dumping = false;
+	return retval;
+}
+
+bool log_trace_enabled(void)
+{
+	return log_trace_ring;
+}
+
+void log_trace(enum log_trace_event event, uint32_t a, uint32_t b)
+{
+	struct timeval now;
+
+	if (!log_trace_ring)
+		return;
+
+	gettimeofday(&now, NULL);
+
+	struct log_trace_record *r = &log_trace_ring[log_trace_count++ & (log_trace_size - 1)];
+	r->time_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+	r->event = event;
+	r->a = a;
+	r->b = b;
+}
+
+COMMAND_HANDLER(handle_log_trace_enable_command)
+{
+	unsigned int size = LOG_TRACE_DEFAULT_SIZE;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+		if (size < 2 || (size & (size - 1))) {
+			command_print(CMD, "number of records must be a power of two");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	if (!log_trace_ring || size != log_trace_size) {
+		struct log_trace_record *ring = calloc(size, sizeof(*ring));
+		if (!ring) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		free(log_trace_ring);
+		log_trace_ring = ring;
+		log_trace_size = size;
+		log_trace_count = 0;
+	}
+
+	command_print(CMD, "trace ring of %u records is enabled", log_trace_size);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_trace_disable_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(log_trace_ring);
+	log_trace_ring = NULL;
+	log_trace_size = 0;
+	log_trace_count = 0;
+
+	command_print(CMD, "trace ring is disabled");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_trace_dump_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return log_trace_dump(CMD_ARGV[0]);
+}
+
+COMMAND_HANDLER(handle_log_trace_dump_on_error_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		free(log_trace_error_file);
+		log_trace_error_file = NULL;
+		if (strcmp(CMD_ARGV[0], "off") != 0) {
+			log_trace_error_file = strdup(CMD_ARGV[0]);
+			if (!log_trace_error_file) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	if (log_trace_error_file)
+		command_print(CMD, "trace ring is dumped to \"%s\" on errors", log_trace_error_file);
+	else
+		command_print(CMD, "trace ring is not dumped on errors");
+	return ERROR_OK;
+}
+
+static const struct command_registration log_trace_subcommand_handlers[] = {
+	{
+		.name = "enable",
+		.handler = handle_log_trace_enable_command,
+		.mode = COMMAND_ANY,
+		.help = "allocate the trace ring and start recording hot path events",
+		.usage = "[num_records]",
+	},
+	{
+		.name = "disable",
+		.handler = handle_log_trace_disable_command,
+		.mode = COMMAND_ANY,
+		.help = "stop recording and release the trace ring",
+		.usage = "",
+	},
+	{
+		.name = "dump",
+		.handler = handle_log_trace_dump_command,
+		.mode = COMMAND_ANY,
+		.help = "write the trace ring to a binary file",
+		.usage = "file_name",
+	},
+	{
+		.name = "dump_on_error",
+		.handler = handle_log_trace_dump_on_error_command,
+		.mode = COMMAND_ANY,
+		.help = "write the trace ring to a binary file whenever an error is logged",
+		.usage = "[file_name | 'off']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration log_command_handlers[] = {
 	{
 		.name = "log_output",
@@ -256,6 +592,13 @@ static const struct command_registration log_command_handlers[] = {
 			"4 adds extra verbose debugging.",
 		.usage = "number",
 	},
+	{
+		.name = "log_trace",
+		.mode = COMMAND_ANY,
+		.help = "binary in-memory trace ring of hot path events",
+		.usage = "",
+		.chain = log_trace_subcommand_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -279,13 +622,29 @@ void log_init(void)
 	}
 
 	if (!log_output)
-		log_output = stderr;
+		log_set_output(stderr);
+
+	/* keep the buffered output on exit() calls and crashes */
+	atexit(log_flush);
+	signal(SIGSEGV, log_fatal_signal);
+	signal(SIGFPE, log_fatal_signal);
+	signal(SIGILL, log_fatal_signal);
+#ifdef SIGBUS
+	signal(SIGBUS, log_fatal_signal);
+#endif
 
 	start = last_time = timeval_ms();
 }
 
 void log_exit(void)
 {
+	log_flush();
+
+	free(log_trace_ring);
+	log_trace_ring = NULL;
+	free(log_trace_error_file);
+	log_trace_error_file = NULL;
+
 	if (log_output && log_output != stderr) {
 		/* Close log file, if it was open and wasn't stderr. */
 		fclose(log_output);
@@ -429,6 +788,9 @@ void keep_alive(void)
 		/* this will keep the GDB connection alive */
 		server_keep_clients_alive();
 
+		/* long operations still show their progress in the log */
+		log_flush();
+
 		/* DANGER!!!! do not add code to invoke e.g. target event processing,
 		 * jim timer processing, etc. it can cause infinite recursion +
 		 * jim event callbacks need to happen at a well defined time,
@@ -63,6 +63,12 @@ __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6)));
 void log_init(void);
 void log_exit(void);
 
+/**
+ * Write out log messages held back in the output buffer. Called when
+ * the server loop goes idle; warnings and errors are flushed at once.
+ */
+void log_flush(void);
+
 int log_register_commands(struct command_context *cmd_ctx);
 
 void keep_alive(void);
@@ -91,6 +97,27 @@ char *alloc_printf(const char *fmt, ...)
 
 char *find_nonprint_char(char *buf, unsigned buf_len);
 
+/** Events recorded in the binary trace ring, see log_trace(). */
+enum log_trace_event {
+	/* adapter queue flush; a: duration in us, b: result */
+	LOG_TRACE_JTAG_QUEUE = 1,
+	/* dap_run(); a: result */
+	LOG_TRACE_DAP_RUN = 2,
+	/* GDB packet handled; a: duration in us, b: first four packet characters */
+	LOG_TRACE_GDB_PACKET = 3,
+	/* error logged; a: source line, b: first four characters of the message */
+	LOG_TRACE_ERROR = 4,
+};
+
+/**
+ * Record a timestamped event in the trace ring, if it is enabled with
+ * the 'log_trace enable' command. Cheap enough for hot paths.
+ */
+void log_trace(enum log_trace_event event, uint32_t a, uint32_t b);
+
+/** @returns true if the trace ring records events. */
+bool log_trace_enabled(void);
+
 extern int debug_level;
 
 /* Avoid fn call and building parameter list if we're not outputting the information.
@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+
+#include "log.h"
+#include "metrics.h"
+#include "replacements.h"
+
+enum metrics_type {
+	METRICS_COUNTER,
+	METRICS_GAUGE,
+	METRICS_HISTOGRAM,
+};
+
+/* histogram bucket upper bounds, in microseconds */
+static const uint64_t metrics_buckets_us[] = {
+	100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000,
+};
+
+#define METRICS_BUCKETS ARRAY_SIZE(metrics_buckets_us)
+
+struct metrics_series {
+	char *labels;
+	/* counter or gauge value; number of samples for histograms */
+	uint64_t value;
+	uint64_t sum_us;
+	uint64_t buckets[METRICS_BUCKETS];
+	struct metrics_series *next;
+};
+
+struct metrics_metric {
+	const char *name;
+	enum metrics_type type;
+	const char *help;
+	struct metrics_series *series;
+	/* the series without labels, to skip the lookup of unlabeled metrics */
+	struct metrics_series *unlabeled;
+};
+
+bool metrics_enabled;
+
+static struct metrics_metric metrics[METRICS_NUM] = {
+	[METRICS_JTAG_QUEUE_SECONDS] = {
+		"openocd_jtag_execute_queue_seconds", METRICS_HISTOGRAM,
+		"Latency of adapter queue flushes",
+	},
+	[METRICS_DAP_RUNS] = {
+		"openocd_dap_runs_total", METRICS_COUNTER,
+		"Number of dap_run() calls",
+	},
+	[METRICS_DAP_TRANSACTIONS] = {
+		"openocd_dap_transactions_total", METRICS_COUNTER,
+		"Number of queued DP and AP register accesses",
+	},
+	[METRICS_USB_TRANSFERS] = {
+		"openocd_usb_transfers_total", METRICS_COUNTER,
+		"Number of libusb transfers per adapter driver",
+	},
+	[METRICS_USB_BYTES] = {
+		"openocd_usb_bytes_total", METRICS_COUNTER,
+		"Bytes moved by libusb transfers per adapter driver",
+	},
+	[METRICS_GDB_PACKET_SECONDS] = {
+		"openocd_gdb_packet_seconds", METRICS_HISTOGRAM,
+		"Time spent handling GDB packets, per packet type",
+	},
+	[METRICS_RTT_BYTES] = {
+		"openocd_rtt_bytes_total", METRICS_COUNTER,
+		"Bytes transferred through RTT channels",
+	},
+	[METRICS_SWO_BYTES] = {
+		"openocd_swo_bytes_total", METRICS_COUNTER,
+		"Bytes of SWO trace data received",
+	},
+	[METRICS_FLASH_WRITE_BYTES] = {
+		"openocd_flash_write_bytes_total", METRICS_COUNTER,
+		"Bytes written to flash banks",
+	},
+	[METRICS_FLASH_WRITE_SECONDS] = {
+		"openocd_flash_write_seconds", METRICS_HISTOGRAM,
+		"Duration of flash bank writes",
+	},
+	[METRICS_FLASH_WRITE_RATE] = {
+		"openocd_flash_write_bytes_per_second", METRICS_GAUGE,
+		"Throughput of the last flash bank write",
+	},
+	[METRICS_SEMIHOSTING_CALL_SECONDS] = {
+		"openocd_semihosting_call_seconds", METRICS_HISTOGRAM,
+		"Time spent servicing semihosting calls, per operation",
+	},
+	[METRICS_SEMIHOSTING_BYTES] = {
+		"openocd_semihosting_bytes_total", METRICS_COUNTER,
+		"Bytes moved by semihosting SYS_READ and SYS_WRITE calls",
+	},
+};
+
+struct metrics_series *metrics_series_get(enum metrics_id id, const char *labels)
+{
+	struct metrics_metric *metric = &metrics[id];
+	struct metrics_series *series;
+
+	if (!labels)
+		labels = "";
+
+	if (!labels[0] && metric->unlabeled)
+		return metric->unlabeled;
+
+	for (series = metric->series; series; series = series->next)
+		if (!strcmp(series->labels, labels))
+			return series;
+
+	series = calloc(1, sizeof(*series));
+	if (!series)
+		return NULL;
+
+	series->labels = strdup(labels);
+	if (!series->labels) {
+		free(series);
+		return NULL;
+	}
+
+	series->next = metric->series;
+	metric->series = series;
+	if (!labels[0])
+		metric->unlabeled = series;
+
+	return series;
+}
+
+void metrics_series_add(struct metrics_series *series, uint64_t value)
+{
+	if (series)
+		series->value += value;
+}
+
+void metrics_add(enum metrics_id id, const char *labels, uint64_t value)
+{
+	if (!metrics_enabled)
+		return;
+
+	metrics_series_add(metrics_series_get(id, labels), value);
+}
+
+void metrics_set(enum metrics_id id, const char *labels, uint64_t value)
+{
+	if (!metrics_enabled)
+		return;
+
+	struct metrics_series *series = metrics_series_get(id, labels);
+
+	if (series)
+		series->value = value;
+}
+
+void metrics_observe(enum metrics_id id, const char *labels,
+		const struct duration *duration)
+{
+	if (!metrics_enabled)
+		return;
+
+	struct metrics_series *series = metrics_series_get(id, labels);
+
+	if (!series)
+		return;
+
+	uint64_t us = (uint64_t)duration->elapsed.tv_sec * 1000000 + duration->elapsed.tv_usec;
+
+	series->value++;
+	series->sum_us += us;
+
+	for (unsigned int i = 0; i < METRICS_BUCKETS; i++) {
+		if (us <= metrics_buckets_us[i]) {
+			series->buckets[i]++;
+			break;
+		}
+	}
+}
+
+struct metrics_text {
+	char *buf;
+	size_t len;
+	size_t size;
+	bool failed;
+};
+
+static void metrics_printf(struct metrics_text *text, const char *fmt, ...)
+	__attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 2, 3)));
+
+static void metrics_printf(struct metrics_text *text, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (text->failed)
+		return;
+
+	while (true) {
+		size_t avail = text->size - text->len;
+
+		va_start(ap, fmt);
+		int n = vsnprintf(text->buf + text->len, avail, fmt, ap);
+		va_end(ap);
+
+		if (n < 0) {
+			text->failed = true;
+			return;
+		}
+
+		if ((size_t)n < avail) {
+			text->len += n;
+			return;
+		}
+
+		size_t size = MAX(text->size * 2, text->len + n + 1);
+		char *buf = realloc(text->buf, size);
+		if (!buf) {
+			text->failed = true;
+			return;
+		}
+		text->buf = buf;
+		text->size = size;
+	}
+}
+
+/* Print "name{labels}" or "name{labels,extra}" */
+static void metrics_print_name(struct metrics_text *text, const char *name,
+		const char *suffix, const char *labels, const char *extra)
+{
+	const char *sep = (labels[0] && extra) ? "," : "";
+
+	if (!labels[0] && !extra)
+		metrics_printf(text, "%s%s ", name, suffix);
+	else
+		metrics_printf(text, "%s%s{%s%s%s} ", name, suffix, labels, sep, extra ? extra : "");
+}
+
+static void metrics_print_histogram(struct metrics_text *text,
+		const struct metrics_metric *metric, const struct metrics_series *series)
+{
+	uint64_t cumulative = 0;
+	char le[32];
+
+	for (unsigned int i = 0; i < METRICS_BUCKETS; i++) {
+		cumulative += series->buckets[i];
+		snprintf(le, sizeof(le), "le=\"%" PRIu64 ".%06" PRIu64 "\"",
+			metrics_buckets_us[i] / 1000000, metrics_buckets_us[i] % 1000000);
+		metrics_print_name(text, metric->name, "_bucket", series->labels, le);
+		metrics_printf(text, "%" PRIu64 "\n", cumulative);
+	}
+
+	metrics_print_name(text, metric->name, "_bucket", series->labels, "le=\"+Inf\"");
+	metrics_printf(text, "%" PRIu64 "\n", series->value);
+	metrics_print_name(text, metric->name, "_sum", series->labels, NULL);
+	metrics_printf(text, "%" PRIu64 ".%06" PRIu64 "\n",
+		series->sum_us / 1000000, series->sum_us % 1000000);
+	metrics_print_name(text, metric->name, "_count", series->labels, NULL);
+	metrics_printf(text, "%" PRIu64 "\n", series->value);
+}
+
+char *metrics_format(void)
+{
+	static const char * const type_names[] = {
+		[METRICS_COUNTER] = "counter",
+		[METRICS_GAUGE] = "gauge",
+		[METRICS_HISTOGRAM] = "histogram",
+	};
+	struct metrics_text text = { 0 };
+
+	for (unsigned int i = 0; i < METRICS_NUM; i++) {
+		const struct metrics_metric *metric = &metrics[i];
+
+		metrics_printf(&text, "# HELP %s %s\n", metric->name, metric->help);
+		metrics_printf(&text, "# TYPE %s %s\n", metric->name, type_names[metric->type]);
+
+		if (!metric->series && metric->type == METRICS_COUNTER)
+			metrics_printf(&text, "%s 0\n", metric->name);
+
+		for (const struct metrics_series *series = metric->series; series; series = series->next) {
+			if (metric->type == METRICS_HISTOGRAM) {
+				metrics_print_histogram(&text, metric, series);
+			} else {
+				metrics_print_name(&text, metric->name, "", series->labels, NULL);
+				metrics_printf(&text, "%" PRIu64 "\n", series->value);
+			}
+		}
+	}
+
+	if (text.failed) {
+		LOG_ERROR("Out of memory");
+		free(text.buf);
+		return NULL;
+	}
+
+	return text.buf;
+}
+
+void metrics_reset(void)
+{
+	for (unsigned int i = 0; i < METRICS_NUM; i++)
+		for (struct metrics_series *series = metrics[i].series; series; series = series->next) {
+			series->value = 0;
+			series->sum_us = 0;
+			memset(series->buckets, 0, sizeof(series->buckets));
+		}
+}
+
+void metrics_free(void)
+{
+	metrics_enabled = false;
+
+	for (unsigned int i = 0; i < METRICS_NUM; i++) {
+		struct metrics_series *series = metrics[i].series;
+
+		while (series) {
+			struct metrics_series *next = series->next;
+			free(series->labels);
+			free(series);
+			series = next;
+		}
+		metrics[i].series = NULL;
+		metrics[i].unlabeled = NULL;
+	}
+}
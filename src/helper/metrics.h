@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_HELPER_METRICS_H
+#define OPENOCD_HELPER_METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "time_support.h"
+
+/** @file
+ * Run-time counters and latency histograms of the adapter, DAP, flash,
+ * semihosting and server layers. They are published in the Prometheus text exposition
+ * format by the metrics server, see server/metrics_server.c.
+ *
+ * Nothing is recorded unless the metrics server is enabled, so that the
+ * instrumented hot paths cost a single test of metrics_enabled.
+ */
+
+enum metrics_id {
+	METRICS_JTAG_QUEUE_SECONDS,
+	METRICS_DAP_RUNS,
+	METRICS_DAP_TRANSACTIONS,
+	METRICS_USB_TRANSFERS,
+	METRICS_USB_BYTES,
+	METRICS_GDB_PACKET_SECONDS,
+	METRICS_RTT_BYTES,
+	METRICS_SWO_BYTES,
+	METRICS_FLASH_WRITE_BYTES,
+	METRICS_FLASH_WRITE_SECONDS,
+	METRICS_FLASH_WRITE_RATE,
+	METRICS_SEMIHOSTING_CALL_SECONDS,
+	METRICS_SEMIHOSTING_BYTES,
+	METRICS_NUM
+};
+
+struct metrics_series;
+
+/** Set while the metrics server runs, record metrics only when true. */
+extern bool metrics_enabled;
+
+/**
+ * Add @a value to a counter.
+ * @param id		The counter.
+ * @param labels	Prometheus label set, e.g. `dir="in"`, or NULL.
+ * @param value		Amount to add.
+ */
+void metrics_add(enum metrics_id id, const char *labels, uint64_t value);
+
+/** Set a gauge to @a value. */
+void metrics_set(enum metrics_id id, const char *labels, uint64_t value);
+
+/** Record the elapsed time of a measured @a duration in a histogram. */
+void metrics_observe(enum metrics_id id, const char *labels,
+		const struct duration *duration);
+
+/**
+ * Look up, or create, the series of @a id with the label set @a labels.
+ * The series stays valid until metrics_free(), so hot paths can cache it
+ * instead of paying a lookup for each update.
+ * @returns The series, NULL when out of memory.
+ */
+struct metrics_series *metrics_series_get(enum metrics_id id, const char *labels);
+
+/** Add @a value to a counter series obtained by metrics_series_get(). */
+void metrics_series_add(struct metrics_series *series, uint64_t value);
+
+/**
+ * Format all metrics as a Prometheus text page.
+ * @returns Allocated string, to be released by the caller with free().
+ */
+char *metrics_format(void);
+
+/** Zero all recorded values, the series are kept. */
+void metrics_reset(void);
+
+/** Release all series and stop recording. */
+void metrics_free(void);
+
+#endif /* OPENOCD_HELPER_METRICS_H */
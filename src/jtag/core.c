@@ -25,6 +25,7 @@
 #include "interface.h"
 #include <transport/transport.h>
 #include <helper/jep106.h>
+#include <helper/metrics.h>
 #include "helper/system.h"
 
 #ifdef HAVE_STRINGS_H
@@ -1017,8 +1018,23 @@ int default_interface_jtag_execute_queue(void)
 
 void jtag_execute_queue_noclear(void)
 {
+	struct duration queue_time;
+	/* only time the flush when someone looks at the result */
+	bool timed = metrics_enabled || log_trace_enabled();
+
 	jtag_flush_queue_count++;
-	jtag_set_error(interface_jtag_execute_queue());
+	if (timed)
+		duration_start(&queue_time);
+	int retval = interface_jtag_execute_queue();
+	jtag_set_error(retval);
+	if (timed) {
+		duration_measure(&queue_time);
+		metrics_observe(METRICS_JTAG_QUEUE_SECONDS, NULL, &queue_time);
+		log_trace(LOG_TRACE_JTAG_QUEUE,
+			queue_time.elapsed.tv_sec * 1000000 + queue_time.elapsed.tv_usec, retval);
+	}
+
+	adapter_call_idle_callbacks();
 
 	if (jtag_flush_queue_sleep > 0) {
 		/* For debug purposes it can be useful to test performance
@@ -1081,7 +1097,13 @@ void jtag_sleep(uint32_t us)
 /* a larger IR length than we ever expect to autoprobe */
 #define JTAG_IRLEN_MAX          60
 
-static int jtag_examine_chain_execute(uint8_t *idcode_buffer, unsigned num_idcode)
+/* Enabled TAPs found by the last successful chain examination, which
+ * "jtag chain_cache" re-verifies instead of examining the chain again */
+static struct jtag_tap **jtag_chain_cache_taps;
+static unsigned int jtag_chain_cache_count;
+static bool jtag_chain_cache_enabled;
+
+static void jtag_examine_chain_queue(uint8_t *idcode_buffer, unsigned num_idcode)
 {
 	struct scan_field field = {
 		.num_bits = num_idcode * 32,
@@ -1095,7 +1117,6 @@ static int jtag_examine_chain_execute(uint8_t *idcode_buffer, unsigned num_idcod
 
 	jtag_add_plain_dr_scan(field.num_bits, field.out_value, field.in_value, TAP_DRPAUSE);
 	jtag_add_tlr();
-	return jtag_execute_queue();
 }
 
 static bool jtag_examine_chain_check(uint8_t *idcodes, unsigned count)
@@ -1209,12 +1230,8 @@ static bool jtag_examine_chain_match_tap(const struct jtag_tap *tap)
 	return false;
 }
 
-/* Try to examine chain layout according to IEEE 1149.1 §12
- * This is called a "blind interrogation" of the scan chain.
- */
-static int jtag_examine_chain(void)
+static unsigned int jtag_examine_chain_max_taps(void)
 {
-	int retval;
 	unsigned max_taps = jtag_tap_count();
 
 	/* Autoprobe up to this many. */
@@ -1222,23 +1239,21 @@ static int jtag_examine_chain(void)
 		max_taps = JTAG_MAX_AUTO_TAPS;
 
 	/* Add room for end-of-chain marker. */
-	max_taps++;
+	return max_taps + 1;
+}
 
-	uint8_t *idcode_buffer = calloc(4, max_taps);
-	if (!idcode_buffer)
-		return ERROR_JTAG_INIT_FAILED;
+/* Try to examine chain layout according to IEEE 1149.1 §12
+ * This is called a "blind interrogation" of the scan chain.
+ * The DR scan collecting BYPASS or IDCODE register contents has
+ * already been executed, see jtag_examine_chain_queue().
+ */
+static int jtag_examine_chain(uint8_t *idcode_buffer, unsigned max_taps)
+{
+	int retval = ERROR_OK;
 
-	/* DR scan to collect BYPASS or IDCODE register contents.
-	 * Then make sure the scan data has both ones and zeroes.
-	 */
-	LOG_DEBUG("DR scan interrogation for IDCODE/BYPASS");
-	retval = jtag_examine_chain_execute(idcode_buffer, max_taps);
-	if (retval != ERROR_OK)
-		goto out;
-	if (!jtag_examine_chain_check(idcode_buffer, max_taps)) {
-		retval = ERROR_JTAG_INIT_FAILED;
-		goto out;
-	}
+	/* Make sure the scan data has both ones and zeroes. */
+	if (!jtag_examine_chain_check(idcode_buffer, max_taps))
+		return ERROR_JTAG_INIT_FAILED;
 
 	/* Point at the 1st predefined tap, if any */
 	struct jtag_tap *tap = jtag_tap_next_enabled(NULL);
@@ -1261,10 +1276,8 @@ static int jtag_examine_chain(void)
 			 * share it with jim_newtap_cmd().
 			 */
 			tap = calloc(1, sizeof(*tap));
-			if (!tap) {
-				retval = ERROR_FAIL;
-				goto out;
-			}
+			if (!tap)
+				return ERROR_FAIL;
 
 			tap->chip = alloc_printf("auto%u", autocount++);
 			tap->tapname = strdup("tap");
@@ -1308,66 +1321,73 @@ static int jtag_examine_chain(void)
 	 */
 	if (jtag_examine_chain_end(idcode_buffer, bit_count, max_taps * 32)) {
 		LOG_ERROR("double-check your JTAG setup (interface, speed, ...)");
-		retval = ERROR_JTAG_INIT_FAILED;
-		goto out;
+		return ERROR_JTAG_INIT_FAILED;
 	}
 
 	/* Return success or, for backwards compatibility if only
 	 * some IDCODE values mismatched, a soft/continuable fault.
 	 */
-out:
-	free(idcode_buffer);
 	return retval;
 }
 
-/*
- * Validate the date loaded by entry to the Capture-IR state, to help
- * find errors related to scan chain configuration (wrong IR lengths)
- * or communication.
- *
- * Entry state can be anything.  On non-error exit, all TAPs are in
- * bypass mode.  On error exits, the scan chain is reset.
- */
-static int jtag_validate_ircapture(void)
+/* Number of bits of the Capture-IR validation scan, including the
+ * 2 bit sentinel; when autoprobing, accommodate huge IR lengths. */
+static int jtag_ircapture_length(void)
 {
-	struct jtag_tap *tap;
-	uint8_t *ir_test = NULL;
-	struct scan_field field;
-	int chain_pos = 0;
-	int retval;
-
-	/* when autoprobing, accommodate huge IR lengths */
 	int total_ir_length = 0;
-	for (tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap)) {
+
+	for (struct jtag_tap *tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap)) {
 		if (tap->ir_length == 0)
 			total_ir_length += JTAG_IRLEN_MAX;
 		else
 			total_ir_length += tap->ir_length;
 	}
 
-	/* increase length to add 2 bit sentinel after scan */
-	total_ir_length += 2;
+	return total_ir_length + 2;
+}
+
+/* True when all enabled TAPs have a known IR length */
+static bool jtag_ir_lengths_known(void)
+{
+	struct jtag_tap *tap = jtag_tap_next_enabled(NULL);
+
+	if (!tap)
+		return false;
+
+	for (; tap; tap = jtag_tap_next_enabled(tap))
+		if (tap->ir_length == 0)
+			return false;
+
+	return true;
+}
 
-	ir_test = malloc(DIV_ROUND_UP(total_ir_length, 8));
+static uint8_t *jtag_ircapture_queue(int total_ir_length)
+{
+	uint8_t *ir_test = malloc(DIV_ROUND_UP(total_ir_length, 8));
 	if (!ir_test)
-		return ERROR_FAIL;
+		return NULL;
 
 	/* after this scan, all TAPs will capture BYPASS instructions */
 	buf_set_ones(ir_test, total_ir_length);
 
-	field.num_bits = total_ir_length;
-	field.out_value = ir_test;
-	field.in_value = ir_test;
-
-	jtag_add_plain_ir_scan(field.num_bits, field.out_value, field.in_value, TAP_IDLE);
+	jtag_add_plain_ir_scan(total_ir_length, ir_test, ir_test, TAP_IDLE);
 
-	LOG_DEBUG("IR capture validation scan");
-	retval = jtag_execute_queue();
-	if (retval != ERROR_OK)
-		goto done;
+	return ir_test;
+}
 
-	tap = NULL;
-	chain_pos = 0;
+/*
+ * Validate the date loaded by entry to the Capture-IR state, to help
+ * find errors related to scan chain configuration (wrong IR lengths)
+ * or communication.
+ *
+ * Entry state can be anything.  On non-error exit, all TAPs are in
+ * bypass mode.  On error exits, the scan chain is reset.
+ */
+static int jtag_validate_ircapture_result(uint8_t *ir_test, int total_ir_length)
+{
+	struct jtag_tap *tap = NULL;
+	int chain_pos = 0;
+	int retval = ERROR_OK;
 
 	for (;; ) {
 		tap = jtag_tap_next_enabled(tap);
@@ -1435,7 +1455,6 @@ static int jtag_validate_ircapture(void)
 	}
 
 done:
-	free(ir_test);
 	if (retval != ERROR_OK) {
 		jtag_add_tlr();
 		jtag_execute_queue();
@@ -1443,6 +1462,142 @@ done:
 	return retval;
 }
 
+static int jtag_validate_ircapture(void)
+{
+	int total_ir_length = jtag_ircapture_length();
+	uint8_t *ir_test = jtag_ircapture_queue(total_ir_length);
+	if (!ir_test)
+		return ERROR_FAIL;
+
+	LOG_DEBUG("IR capture validation scan");
+	int retval = jtag_execute_queue();
+	if (retval == ERROR_OK) {
+		retval = jtag_validate_ircapture_result(ir_test, total_ir_length);
+	} else {
+		jtag_add_tlr();
+		jtag_execute_queue();
+	}
+
+	free(ir_test);
+	return retval;
+}
+
+static void jtag_chain_cache_clear(void)
+{
+	free(jtag_chain_cache_taps);
+	jtag_chain_cache_taps = NULL;
+	jtag_chain_cache_count = 0;
+}
+
+/* Remember the enabled TAPs after a successful examination */
+static void jtag_chain_cache_save(void)
+{
+	jtag_chain_cache_clear();
+
+	unsigned int count = jtag_tap_count_enabled();
+	struct jtag_tap **taps = malloc(count * sizeof(*taps));
+	if (!taps)
+		return;
+
+	struct jtag_tap *tap = jtag_tap_next_enabled(NULL);
+	for (unsigned int i = 0; i < count; i++, tap = jtag_tap_next_enabled(tap))
+		taps[i] = tap;
+
+	jtag_chain_cache_taps = taps;
+	jtag_chain_cache_count = count;
+}
+
+static bool jtag_chain_cache_valid(void)
+{
+	if (!jtag_chain_cache_enabled || !jtag_chain_cache_count)
+		return false;
+
+	/* the same TAPs must still be enabled */
+	struct jtag_tap *tap = jtag_tap_next_enabled(NULL);
+	for (unsigned int i = 0; i < jtag_chain_cache_count; i++, tap = jtag_tap_next_enabled(tap))
+		if (tap != jtag_chain_cache_taps[i])
+			return false;
+
+	return !tap;
+}
+
+/* Confirm the cached chain with one queue flush: a DR scan which must
+ * return exactly the known IDCODE and BYPASS bits followed by the
+ * end-of-chain marker, then the Capture-IR validation scan. */
+static int jtag_chain_cache_verify(void)
+{
+	unsigned int dr_bits = 32;
+	for (unsigned int i = 0; i < jtag_chain_cache_count; i++)
+		dr_bits += jtag_chain_cache_taps[i]->has_idcode ? 32 : 1;
+
+	uint8_t *idcode_buffer = malloc(DIV_ROUND_UP(dr_bits, 8));
+	int total_ir_length = jtag_ircapture_length();
+	uint8_t *ir_test = NULL;
+	int retval = ERROR_FAIL;
+
+	if (!idcode_buffer)
+		goto out;
+
+	buf_set_ones(idcode_buffer, dr_bits);
+	jtag_add_tlr();
+	jtag_add_plain_dr_scan(dr_bits, idcode_buffer, idcode_buffer, TAP_DRPAUSE);
+	jtag_add_tlr();
+	ir_test = jtag_ircapture_queue(total_ir_length);
+	if (!ir_test)
+		goto out;
+
+	LOG_DEBUG("JTAG chain re-verification scan");
+	retval = jtag_execute_queue();
+	if (retval != ERROR_OK)
+		goto out;
+
+	unsigned int bit_count = 0;
+	for (unsigned int i = 0; i < jtag_chain_cache_count; i++) {
+		struct jtag_tap *tap = jtag_chain_cache_taps[i];
+
+		if (tap->has_idcode) {
+			uint32_t idcode = buf_get_u32(idcode_buffer, bit_count, 32);
+			if (idcode != tap->idcode) {
+				LOG_DEBUG("%s: IDCODE 0x%08" PRIx32 " instead of 0x%08" PRIx32,
+					tap->dotted_name, idcode, tap->idcode);
+				retval = ERROR_JTAG_INIT_FAILED;
+				goto out;
+			}
+			bit_count += 32;
+		} else {
+			if (buf_get_u32(idcode_buffer, bit_count, 1)) {
+				LOG_DEBUG("%s: BYPASS bit is not zero", tap->dotted_name);
+				retval = ERROR_JTAG_INIT_FAILED;
+				goto out;
+			}
+			bit_count += 1;
+		}
+	}
+
+	if (!jtag_idcode_is_final(buf_get_u32(idcode_buffer, bit_count, 32))) {
+		LOG_DEBUG("unexpected data after end of chain");
+		retval = ERROR_JTAG_INIT_FAILED;
+		goto out;
+	}
+
+	retval = jtag_validate_ircapture_result(ir_test, total_ir_length);
+
+out:
+	free(ir_test);
+	free(idcode_buffer);
+	return retval;
+}
+
+void jtag_set_chain_cache(bool enable)
+{
+	jtag_chain_cache_enabled = enable;
+}
+
+bool jtag_will_cache_chain(void)
+{
+	return jtag_chain_cache_enabled;
+}
+
 void jtag_tap_init(struct jtag_tap *tap)
 {
 	unsigned ir_len_bits;
@@ -1480,6 +1635,7 @@ void jtag_tap_init(struct jtag_tap *tap)
 
 void jtag_tap_free(struct jtag_tap *tap)
 {
+	jtag_chain_cache_clear();
 	jtag_unregister_event_callback(&jtag_reset_callback, tap);
 
 	struct jtag_tap_event_action *jteap = tap->event_action;
@@ -1527,16 +1683,53 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 		/* REVISIT default clock will often be too fast ... */
 	}
 
-	jtag_add_tlr();
-	retval = jtag_execute_queue();
-	if (retval != ERROR_OK)
-		return retval;
+	/* After a reset, the chain known from the last examination
+	 * only needs to be confirmed.
+	 */
+	if (jtag_chain_cache_valid()) {
+		retval = jtag_chain_cache_verify();
+		if (retval == ERROR_OK) {
+			LOG_DEBUG("JTAG chain matches the cached one");
+			jtag_notify_event(JTAG_TAP_EVENT_SETUP);
+			return ERROR_OK;
+		}
+		LOG_INFO("JTAG chain differs from the cached one, examining it again");
+	}
+	jtag_chain_cache_clear();
+
+	unsigned int max_taps = jtag_examine_chain_max_taps();
+	uint8_t *idcode_buffer = calloc(4, max_taps);
+	if (!idcode_buffer)
+		return ERROR_JTAG_INIT_FAILED;
 
 	/* Examine DR values first.  This discovers problems which will
 	 * prevent communication ... hardware issues like TDO stuck, or
 	 * configuring the wrong number of (enabled) TAPs.
+	 *
+	 * When no IR length has to be autoprobed, the Capture-IR
+	 * validation scan goes out in the same queue flush.
 	 */
-	retval = jtag_examine_chain();
+	jtag_add_tlr();
+	LOG_DEBUG("DR scan interrogation for IDCODE/BYPASS");
+	jtag_examine_chain_queue(idcode_buffer, max_taps);
+
+	uint8_t *ir_test = NULL;
+	int total_ir_length = 0;
+	unsigned int tap_count = jtag_tap_count();
+	if (jtag_ir_lengths_known()) {
+		total_ir_length = jtag_ircapture_length();
+		ir_test = jtag_ircapture_queue(total_ir_length);
+	}
+
+	retval = jtag_execute_queue();
+	if (retval != ERROR_OK) {
+		free(ir_test);
+		free(idcode_buffer);
+		return retval;
+	}
+
+	retval = jtag_examine_chain(idcode_buffer, max_taps);
+	free(idcode_buffer);
 	switch (retval) {
 		case ERROR_OK:
 			/* complete success */
@@ -1562,7 +1755,13 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 	 * latter is uncommon, but easily worked around:  provide
 	 * ircapture/irmask values during TAP setup.)
 	 */
-	retval = jtag_validate_ircapture();
+	if (ir_test && jtag_tap_count() == tap_count) {
+		retval = jtag_validate_ircapture_result(ir_test, total_ir_length);
+	} else {
+		/* autoprobed TAPs were added, scan again */
+		retval = jtag_validate_ircapture();
+	}
+	free(ir_test);
 	if (retval != ERROR_OK) {
 		/* The target might be powered down. The user
 		 * can power it up and reset it after firing
@@ -1571,10 +1770,12 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 		issue_setup = false;
 	}
 
-	if (issue_setup)
+	if (issue_setup) {
+		jtag_chain_cache_save();
 		jtag_notify_event(JTAG_TAP_EVENT_SETUP);
-	else
+	} else {
 		LOG_WARNING("Bypassing JTAG setup events due to errors");
+	}
 
 
 	return ERROR_OK;
@@ -1936,3 +2137,68 @@ int adapter_poll_trace(uint8_t *buf, size_t *size)
 
 	return ERROR_FAIL;
 }
+
+struct adapter_idle_callback {
+	int (*callback)(void *priv);
+	void *priv;
+	struct adapter_idle_callback *next;
+};
+
+static struct adapter_idle_callback *adapter_idle_callbacks;
+
+int adapter_register_idle_callback(int (*callback)(void *priv), void *priv)
+{
+	struct adapter_idle_callback **p = &adapter_idle_callbacks;
+
+	if (!callback)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	while (*p)
+		p = &(*p)->next;
+
+	*p = malloc(sizeof(**p));
+	if (!*p) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	(*p)->callback = callback;
+	(*p)->priv = priv;
+	(*p)->next = NULL;
+
+	return ERROR_OK;
+}
+
+int adapter_unregister_idle_callback(int (*callback)(void *priv), void *priv)
+{
+	for (struct adapter_idle_callback **p = &adapter_idle_callbacks; *p; p = &(*p)->next) {
+		struct adapter_idle_callback *c = *p;
+
+		if (c->callback == callback && c->priv == priv) {
+			*p = c->next;
+			free(c);
+			return ERROR_OK;
+		}
+	}
+
+	return ERROR_FAIL;
+}
+
+void adapter_call_idle_callbacks(void)
+{
+	static bool running;
+
+	if (!adapter_idle_callbacks || running)
+		return;
+
+	running = true;
+
+	struct adapter_idle_callback *next;
+	for (struct adapter_idle_callback *c = adapter_idle_callbacks; c; c = next) {
+		/* the callback may unregister itself */
+		next = c->next;
+		c->callback(c->priv);
+	}
+
+	running = false;
+}
@@ -13,7 +13,9 @@
 #include <string.h>
 
 #include <helper/log.h>
+#include <helper/metrics.h>
 #include <jtag/adapter.h>
+#include <jtag/interface.h>
 #include "libusb_helper.h"
 
 /*
@@ -22,6 +24,8 @@
  */
 #define MAX_USB_PORTS	7
 
+extern struct adapter_driver *adapter_driver;
+
 static struct libusb_context *jtag_libusb_context; /**< Libusb context **/
 static struct libusb_device **devs; /**< The usb device list **/
 
@@ -226,6 +230,27 @@ void jtag_libusb_close(struct libusb_device_handle *dev)
 	libusb_exit(jtag_libusb_context);
 }
 
+static void jtag_libusb_count_transfer(bool in, int transferred)
+{
+	/* the adapter driver does not change, look the series up only once */
+	static struct metrics_series *transfers[2], *bytes[2];
+
+	if (!metrics_enabled)
+		return;
+
+	if (!transfers[in]) {
+		char labels[64];
+
+		snprintf(labels, sizeof(labels), "driver=\"%s\",dir=\"%s\"",
+			adapter_driver ? adapter_driver->name : "", in ? "in" : "out");
+		transfers[in] = metrics_series_get(METRICS_USB_TRANSFERS, labels);
+		bytes[in] = metrics_series_get(METRICS_USB_BYTES, labels);
+	}
+
+	metrics_series_add(transfers[in], 1);
+	metrics_series_add(bytes[in], transferred);
+}
+
 int jtag_libusb_control_transfer(struct libusb_device_handle *dev, uint8_t request_type,
 		uint8_t request, uint16_t value, uint16_t index, char *bytes,
 		uint16_t size, unsigned int timeout, int *transferred)
@@ -243,6 +268,8 @@ int jtag_libusb_control_transfer(struct libusb_device_handle *dev, uint8_t reque
 	if (transferred)
 		*transferred = retval;
 
+	jtag_libusb_count_transfer(request_type & LIBUSB_ENDPOINT_IN, retval);
+
 	return ERROR_OK;
 }
 
@@ -260,6 +287,8 @@ int jtag_libusb_bulk_write(struct libusb_device_handle *dev, int ep, char *bytes
 		return jtag_libusb_error(ret);
 	}
 
+	jtag_libusb_count_transfer(false, *transferred);
+
 	return ERROR_OK;
 }
 
@@ -277,6 +306,8 @@ int jtag_libusb_bulk_read(struct libusb_device_handle *dev, int ep, char *bytes,
 		return jtag_libusb_error(ret);
 	}
 
+	jtag_libusb_count_transfer(true, *transferred);
+
 	return ERROR_OK;
 }
 
@@ -256,6 +256,11 @@ void jtag_set_verify_capture_ir(bool enable);
 /** @returns True if IR scan verification will be performed. */
 bool jtag_will_verify_capture_ir(void);
 
+/** Enable or disable re-verification of the cached scan chain in jtag_init_inner(). */
+void jtag_set_chain_cache(bool enable);
+/** @returns True if the cached scan chain will only be re-verified. */
+bool jtag_will_cache_chain(void);
+
 /** Set ms to sleep after jtag_execute_queue() flushes queue. Debug purposes. */
 void jtag_set_flush_queue_sleep(int ms);
 
@@ -525,6 +530,20 @@ void jtag_execute_queue_noclear(void);
 /** @returns the number of times the scan queue has been flushed */
 int jtag_get_flush_queue_count(void);
 
+/**
+ * Register a function to be called each time the adapter has finished
+ * executing a queue of JTAG or DAP operations.
+ *
+ * This lets services that only need adapter I/O independent of the command
+ * queue, such as draining captured SWO data, keep running while a long
+ * operation (flash programming, dump_image, ...) holds the server loop.
+ * Callbacks must not queue or execute JTAG/DAP operations themselves, and
+ * are responsible for their own rate limiting.
+ */
+int adapter_register_idle_callback(int (*callback)(void *priv), void *priv);
+int adapter_unregister_idle_callback(int (*callback)(void *priv), void *priv);
+void adapter_call_idle_callbacks(void);
+
 /** Report Tcl event to all TAPs */
 void jtag_notify_event(enum jtag_event);
 
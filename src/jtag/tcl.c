@@ -670,6 +670,23 @@ COMMAND_HANDLER(handle_jtag_names)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_jtag_chain_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		jtag_set_chain_cache(enable);
+	}
+
+	const char *status = jtag_will_cache_chain() ? "enabled" : "disabled";
+	command_print(CMD, "JTAG chain cache is %s", status);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_jtag_init_command)
 {
 	if (CMD_ARGC != 0)
@@ -774,6 +791,15 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.help = "Returns list of all JTAG tap names.",
 		.usage = "",
 	},
+	{
+		.name = "chain_cache",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_chain_cache_command,
+		.help = "Display or assign flag controlling whether 'jtag arp_init' "
+			"only re-verifies the scan chain found by the last "
+			"successful examination.",
+		.usage = "['enable'|'disable']",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
@@ -167,8 +167,7 @@ static int efinix_load(struct pld_device *pld_device, const char *filename)
 	if (retval != ERROR_OK)
 		return retval;
 
-	for (size_t i = 0; i < bit_file.length; i++)
-		bit_file.data[i] = flip_u32(bit_file.data[i], 8);
+	buf_flip_u8(bit_file.data, bit_file.data, bit_file.length);
 
 	/* shift in the bitstream */
 	field[0].num_bits = bit_file.length * 8;
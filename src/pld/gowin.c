@@ -358,8 +358,7 @@ static int gowin_load_to_sram(struct pld_device *pld_device, const char *filenam
 	if (retval != ERROR_OK)
 		return retval;
 
-	for (unsigned int i = 0; i < bit_file.raw_file.length; i++)
-		bit_file.raw_file.data[i] = flip_u32(bit_file.raw_file.data[i], 8);
+	buf_flip_u8(bit_file.raw_file.data, bit_file.raw_file.data, bit_file.raw_file.length);
 
 	uint32_t id;
 	retval = gowin_read_register(tap, IDCODE, &id);
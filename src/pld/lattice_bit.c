@@ -79,8 +79,9 @@ static int lattice_read_bit_file(struct lattice_bit_file *bit_file, const char *
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	for (size_t i = bit_file->offset; i < bit_file->raw_bit.length; i++)
-		bit_file->raw_bit.data[i] = flip_u32(bit_file->raw_bit.data[i], 8);
+	if (bit_file->offset < bit_file->raw_bit.length)
+		buf_flip_u8(bit_file->raw_bit.data + bit_file->offset, bit_file->raw_bit.data + bit_file->offset,
+			bit_file->raw_bit.length - bit_file->offset);
 
 	return ERROR_OK;
 }
@@ -13,6 +13,10 @@
 #include "xilinx_bit.h"
 #include "pld.h"
 
+/* bitstream bytes per scan, and scans per queue when loading */
+#define VIRTEX2_LOAD_CHUNK (64 * 1024)
+#define VIRTEX2_LOAD_CHUNKS_PER_QUEUE 16
+
 static const struct virtex2_command_set virtex2_default_commands = {
 	.cfg_out   = 0x04,
 	.cfg_in    = 0x05,
@@ -228,39 +232,55 @@ static int virtex2_load_cleanup(struct pld_device *pld_device)
 static int virtex2_load(struct pld_device *pld_device, const char *filename)
 {
 	struct virtex2_pld_device *virtex2_info = pld_device->driver_priv;
-	struct xilinx_bit_file bit_file;
-	int retval;
-	unsigned int i;
+	struct xilinx_bit_stream bit_stream;
 	struct scan_field field;
+	size_t read_count;
+	int retval;
 
-	field.in_value = NULL;
-
-	retval = xilinx_read_bit_file(&bit_file, filename);
+	retval = xilinx_open_bit_stream(&bit_stream, filename);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = virtex2_load_prepare(pld_device);
-	if (retval != ERROR_OK) {
-		xilinx_free_bit_file(&bit_file);
-		return retval;
+	uint8_t *chunk = malloc(VIRTEX2_LOAD_CHUNK);
+	if (!chunk) {
+		LOG_ERROR("Out of memory");
+		xilinx_close_bit_stream(&bit_stream);
+		return ERROR_FAIL;
 	}
 
-	for (i = 0; i < bit_file.length; i++)
-		bit_file.data[i] = flip_u32(bit_file.data[i], 8);
+	retval = virtex2_load_prepare(pld_device);
+	if (retval != ERROR_OK)
+		goto out;
+
+	/* Stream the data in chunks, pausing the shift in Pause-DR between
+	 * them. The scans copy the data, so the queue is flushed every few
+	 * chunks to keep the memory bounded. */
+	field.in_value = NULL;
+	field.out_value = chunk;
+	for (unsigned int chunks = 1; ; chunks++) {
+		retval = xilinx_read_bit_stream(&bit_stream, chunk, VIRTEX2_LOAD_CHUNK, &read_count);
+		if (retval != ERROR_OK || read_count == 0)
+			break;
 
-	field.num_bits = bit_file.length * 8;
-	field.out_value = bit_file.data;
+		buf_flip_u8(chunk, chunk, read_count);
 
-	jtag_add_dr_scan(virtex2_info->tap, 1, &field, TAP_DRPAUSE);
-	retval = jtag_execute_queue();
-	if (retval != ERROR_OK) {
-		xilinx_free_bit_file(&bit_file);
-		return retval;
-	}
+		field.num_bits = read_count * 8;
+		jtag_add_dr_scan(virtex2_info->tap, 1, &field, TAP_DRPAUSE);
 
-	retval = virtex2_load_cleanup(pld_device);
+		if (chunks % VIRTEX2_LOAD_CHUNKS_PER_QUEUE == 0) {
+			retval = jtag_execute_queue();
+			if (retval != ERROR_OK)
+				break;
+		}
+	}
+	if (retval == ERROR_OK)
+		retval = jtag_execute_queue();
+	if (retval == ERROR_OK)
+		retval = virtex2_load_cleanup(pld_device);
 
-	xilinx_free_bit_file(&bit_file);
+out:
+	free(chunk);
+	xilinx_close_bit_stream(&bit_stream);
 
 	return retval;
 }
@@ -47,7 +47,13 @@ static int read_section(FILE *input_file, int length_size, char section,
 	if (buffer_length)
 		*buffer_length = length;
 
+	/* leave the content to the caller */
+	if (!buffer)
+		return ERROR_OK;
+
 	*buffer = malloc(length);
+	if (!*buffer)
+		return ERROR_PLD_FILE_LOAD_FAILED;
 
 	read_count = fread(*buffer, 1, length, input_file);
 	if (read_count != length)
@@ -56,20 +62,12 @@ static int read_section(FILE *input_file, int length_size, char section,
 	return ERROR_OK;
 }
 
-int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
+/* Read the header sections up to the length of the data section */
+static int xilinx_read_bit_header(struct xilinx_bit_file *bit_file, FILE *input_file,
+		const char *filename)
 {
-	FILE *input_file;
 	int read_count;
 
-	if (!filename || !bit_file)
-		return ERROR_COMMAND_SYNTAX_ERROR;
-
-	input_file = fopen(filename, "rb");
-	if (!input_file) {
-		LOG_ERROR("couldn't open %s: %s", filename, strerror(errno));
-		return ERROR_PLD_FILE_LOAD_FAILED;
-	}
-
 	bit_file->source_file = NULL;
 	bit_file->part_name = NULL;
 	bit_file->date = NULL;
@@ -79,48 +77,119 @@ int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
 	read_count = fread(bit_file->unknown_header, 1, 13, input_file);
 	if (read_count != 13) {
 		LOG_ERROR("couldn't read unknown_header from file '%s'", filename);
-		fclose(input_file);
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 2, 'a', NULL, &bit_file->source_file) != ERROR_OK) {
+	if (read_section(input_file, 2, 'a', NULL, &bit_file->source_file) != ERROR_OK ||
+			read_section(input_file, 2, 'b', NULL, &bit_file->part_name) != ERROR_OK ||
+			read_section(input_file, 2, 'c', NULL, &bit_file->date) != ERROR_OK ||
+			read_section(input_file, 2, 'd', NULL, &bit_file->time) != ERROR_OK ||
+			read_section(input_file, 4, 'e', &bit_file->length, NULL) != ERROR_OK) {
 		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 2, 'b', NULL, &bit_file->part_name) != ERROR_OK) {
-		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
+	LOG_DEBUG("bit_file: %s %s %s,%s %" PRIu32 "", bit_file->source_file, bit_file->part_name,
+		bit_file->date, bit_file->time, bit_file->length);
+
+	return ERROR_OK;
+}
+
+int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
+{
+	FILE *input_file;
+
+	if (!filename || !bit_file)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	input_file = fopen(filename, "rb");
+	if (!input_file) {
+		LOG_ERROR("couldn't open %s: %s", filename, strerror(errno));
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 2, 'c', NULL, &bit_file->date) != ERROR_OK) {
-		xilinx_free_bit_file(bit_file);
+	int retval = xilinx_read_bit_header(bit_file, input_file, filename);
+	if (retval != ERROR_OK) {
 		fclose(input_file);
-		return ERROR_PLD_FILE_LOAD_FAILED;
+		return retval;
 	}
 
-	if (read_section(input_file, 2, 'd', NULL, &bit_file->time) != ERROR_OK) {
+	bit_file->data = malloc(bit_file->length);
+	if (!bit_file->data ||
+			fread(bit_file->data, 1, bit_file->length, input_file) != bit_file->length) {
 		xilinx_free_bit_file(bit_file);
 		fclose(input_file);
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	if (read_section(input_file, 4, 'e', &bit_file->length, &bit_file->data) != ERROR_OK) {
-		xilinx_free_bit_file(bit_file);
-		fclose(input_file);
+	fclose(input_file);
+
+	return ERROR_OK;
+}
+
+int xilinx_open_bit_stream(struct xilinx_bit_stream *stream, const char *filename)
+{
+	if (!filename || !stream)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	stream->file = fopen(filename, "rb");
+	if (!stream->file) {
+		LOG_ERROR("couldn't open %s: %s", filename, strerror(errno));
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	LOG_DEBUG("bit_file: %s %s %s,%s %" PRIu32 "", bit_file->source_file, bit_file->part_name,
-		bit_file->date, bit_file->time, bit_file->length);
+	const char *suffix = strrchr(filename, '.');
+	if (suffix && strcasecmp(suffix, ".bin") == 0) {
+		/* raw configuration data */
+		if (fseek(stream->file, 0, SEEK_END) != 0) {
+			LOG_ERROR("Failed to get length of file %s: %s", filename, strerror(errno));
+			xilinx_close_bit_stream(stream);
+			return ERROR_PLD_FILE_LOAD_FAILED;
+		}
+		long length = ftell(stream->file);
+		if (length < 0 || length > UINT32_MAX || fseek(stream->file, 0, SEEK_SET) != 0) {
+			LOG_ERROR("Failed to get length of file %s: %s", filename, strerror(errno));
+			xilinx_close_bit_stream(stream);
+			return ERROR_PLD_FILE_LOAD_FAILED;
+		}
+		stream->remaining = length;
+		return ERROR_OK;
+	}
 
-	fclose(input_file);
+	struct xilinx_bit_file bit_file;
+	int retval = xilinx_read_bit_header(&bit_file, stream->file, filename);
+	if (retval != ERROR_OK) {
+		xilinx_close_bit_stream(stream);
+		return retval;
+	}
+	stream->remaining = bit_file.length;
+	xilinx_free_bit_file(&bit_file);
 
 	return ERROR_OK;
 }
 
+int xilinx_read_bit_stream(struct xilinx_bit_stream *stream, uint8_t *buffer, size_t size,
+		size_t *read_count)
+{
+	size = MIN(size, stream->remaining);
+
+	*read_count = fread(buffer, 1, size, stream->file);
+	if (*read_count != size) {
+		LOG_ERROR("bitstream file truncated");
+		return ERROR_PLD_FILE_LOAD_FAILED;
+	}
+	stream->remaining -= size;
+
+	return ERROR_OK;
+}
+
+void xilinx_close_bit_stream(struct xilinx_bit_stream *stream)
+{
+	if (stream->file)
+		fclose(stream->file);
+	stream->file = NULL;
+}
+
 void xilinx_free_bit_file(struct xilinx_bit_file *bit_file)
 {
 	free(bit_file->source_file);
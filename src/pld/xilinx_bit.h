@@ -10,6 +10,8 @@
 
 #include "helper/types.h"
 
+#include <stdio.h>
+
 struct xilinx_bit_file {
 	uint8_t unknown_header[13];
 	uint8_t *source_file;
@@ -24,4 +26,23 @@ int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
 
 void xilinx_free_bit_file(struct xilinx_bit_file *bit_file);
 
+/** Configuration data of a bitstream file, read in chunks */
+struct xilinx_bit_stream {
+	FILE *file;
+	/* bytes of configuration data not yet read */
+	uint32_t remaining;
+};
+
+/**
+ * Open the data section of a .bit file, or a whole raw .bin file, for
+ * reading with xilinx_read_bit_stream().
+ */
+int xilinx_open_bit_stream(struct xilinx_bit_stream *stream, const char *filename);
+
+/** Read up to @a size bytes, @a read_count is 0 at the end of the data. */
+int xilinx_read_bit_stream(struct xilinx_bit_stream *stream, uint8_t *buffer, size_t size,
+		size_t *read_count);
+
+void xilinx_close_bit_stream(struct xilinx_bit_stream *stream);
+
 #endif /* OPENOCD_PLD_XILINX_BIT_H */
@@ -35,6 +35,9 @@ static const struct rtos_type *rtos_types[] = {
 };
 
 static int rtos_try_next(struct target *target);
+static void rtos_thread_regs_invalidate(struct rtos *rtos);
+static int rtos_target_event_handler(struct target *target,
+		enum target_event event, void *priv);
 
 int rtos_smp_init(struct target *target)
 {
@@ -69,6 +72,9 @@ static int os_alloc(struct target *target, const struct rtos_type *ostype)
 	os->gdb_thread_packet = rtos_thread_packet;
 	os->gdb_target_for_threadid = rtos_target_for_threadid;
 
+	/* Cached thread registers are only valid while the target stays halted. */
+	target_register_event_callback(rtos_target_event_handler, os);
+
 	return JIM_OK;
 }
 
@@ -77,6 +83,7 @@ static void os_free(struct target *target)
 	if (!target->rtos)
 		return;
 
+	target_unregister_event_callback(rtos_target_event_handler, target->rtos);
 	free(target->rtos->symbols);
 	rtos_free_threadlist(target->rtos);
 	free(target->rtos);
@@ -499,6 +506,124 @@ static int rtos_put_gdb_reg_list(struct connection *connection,
 	return ERROR_OK;
 }
 
+static void rtos_thread_regs_invalidate(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->thread_regs_count; i++)
+		free(rtos->thread_regs[i].reg_list);
+	free(rtos->thread_regs);
+	rtos->thread_regs = NULL;
+	rtos->thread_regs_count = 0;
+	rtos->thread_regs_fetched = false;
+}
+
+static int rtos_target_event_handler(struct target *target,
+		enum target_event event, void *priv)
+{
+	struct rtos *os = priv;
+
+	if (target != os->target)
+		return ERROR_OK;
+
+	switch (event) {
+	case TARGET_EVENT_HALTED:
+	case TARGET_EVENT_RESUMED:
+		rtos_thread_regs_invalidate(os);
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+static struct rtos_thread_regs *rtos_thread_regs_find(struct rtos *rtos,
+		threadid_t threadid)
+{
+	for (int i = 0; i < rtos->thread_regs_count; i++)
+		if (rtos->thread_regs[i].threadid == threadid)
+			return &rtos->thread_regs[i];
+
+	return NULL;
+}
+
+static int rtos_thread_regs_add(struct rtos *rtos, threadid_t threadid,
+		struct rtos_thread_regs **regs)
+{
+	struct rtos_reg *reg_list;
+	int num_regs;
+
+	int retval = rtos->type->get_thread_reg_list(rtos, threadid, &reg_list, &num_regs);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct rtos_thread_regs *new_regs = realloc(rtos->thread_regs,
+			(rtos->thread_regs_count + 1) * sizeof(*new_regs));
+	if (!new_regs) {
+		free(reg_list);
+		return ERROR_FAIL;
+	}
+
+	rtos->thread_regs = new_regs;
+	new_regs = &rtos->thread_regs[rtos->thread_regs_count++];
+	new_regs->threadid = threadid;
+	new_regs->reg_list = reg_list;
+	new_regs->num_regs = num_regs;
+
+	if (regs)
+		*regs = new_regs;
+	return ERROR_OK;
+}
+
+/* Front ends that show a backtrace for every thread request the registers
+ * of all threads after each stop. Read all stacked frames in one pass on the
+ * first request and answer the following ones from memory. */
+static void rtos_thread_regs_fetch_all(struct rtos *rtos)
+{
+	rtos->thread_regs_fetched = true;
+
+	for (int i = 0; i < rtos->thread_count; i++) {
+		const struct thread_detail *detail = &rtos->thread_details[i];
+
+		if (!detail->exists)
+			continue;
+		/* registers of the running thread come from the target itself */
+		if (detail->threadid == rtos->current_thread)
+			continue;
+		if (rtos_thread_regs_find(rtos, detail->threadid))
+			continue;
+
+		if (rtos_thread_regs_add(rtos, detail->threadid, NULL) != ERROR_OK)
+			LOG_DEBUG("RTOS: failed to prefetch registers of thread 0x%" PRIx64,
+					detail->threadid);
+	}
+}
+
+static int rtos_thread_regs_get(struct rtos *rtos, threadid_t threadid,
+		struct rtos_thread_regs **regs)
+{
+	*regs = rtos_thread_regs_find(rtos, threadid);
+
+	/* the running thread's registers can be written behind our back
+	 * (e.g. by a 'G' packet), so they are never served from the cache */
+	if (*regs && threadid == rtos->current_thread) {
+		free((*regs)->reg_list);
+		**regs = rtos->thread_regs[--rtos->thread_regs_count];
+		*regs = NULL;
+	}
+
+	if (*regs)
+		return ERROR_OK;
+
+	if (!rtos->thread_regs_fetched) {
+		rtos_thread_regs_fetch_all(rtos);
+		*regs = rtos_thread_regs_find(rtos, threadid);
+		if (*regs)
+			return ERROR_OK;
+	}
+
+	return rtos_thread_regs_add(rtos, threadid, regs);
+}
+
 /** Look through all registers to find this register. */
 int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 {
@@ -517,6 +642,16 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 										current_threadid,
 										target->rtos->current_thread);
 
+		struct rtos_thread_regs *regs = rtos_thread_regs_find(target->rtos, current_threadid);
+		if (regs && current_threadid != target->rtos->current_thread) {
+			for (int i = 0; i < regs->num_regs; ++i) {
+				if (regs->reg_list[i].number == (uint32_t)reg_num) {
+					rtos_put_gdb_reg_list(connection, regs->reg_list + i, 1);
+					return ERROR_OK;
+				}
+			}
+		}
+
 		int retval;
 		if (target->rtos->type->get_thread_reg) {
 			reg_list = calloc(1, sizeof(*reg_list));
@@ -560,25 +695,37 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 			(current_threadid != 0) &&
 			((current_threadid != target->rtos->current_thread) ||
 			(target->smp))) {	/* in smp several current thread are possible */
-		struct rtos_reg *reg_list;
-		int num_regs;
+		struct rtos_thread_regs *regs;
 
 		LOG_DEBUG("RTOS: getting register list for thread 0x%" PRIx64
 				  ", target->rtos->current_thread=0x%" PRIx64 "\r\n",
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
-				current_threadid,
-				&reg_list,
-				&num_regs);
+		if (target->rtos->type->live_thread_regs) {
+			struct rtos_reg *reg_list;
+			int num_regs;
+
+			int retval = target->rtos->type->get_thread_reg_list(target->rtos,
+					current_threadid, &reg_list, &num_regs);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("RTOS: failed to get register list");
+				return retval;
+			}
+
+			rtos_put_gdb_reg_list(connection, reg_list, num_regs);
+			free(reg_list);
+
+			return ERROR_OK;
+		}
+
+		int retval = rtos_thread_regs_get(target->rtos, current_threadid, &regs);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("RTOS: failed to get register list");
 			return retval;
 		}
 
-		rtos_put_gdb_reg_list(connection, reg_list, num_regs);
-		free(reg_list);
+		rtos_put_gdb_reg_list(connection, regs->reg_list, regs->num_regs);
 
 		return ERROR_OK;
 	}
@@ -594,6 +741,7 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_thread_regs_invalidate(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
@@ -687,13 +835,17 @@ static int rtos_try_next(struct target *target)
 
 int rtos_update_threads(struct target *target)
 {
-	if ((target->rtos) && (target->rtos->type))
+	if ((target->rtos) && (target->rtos->type)) {
+		rtos_thread_regs_invalidate(target->rtos);
 		target->rtos->type->update_threads(target->rtos);
+	}
 	return ERROR_OK;
 }
 
 void rtos_free_threadlist(struct rtos *rtos)
 {
+	rtos_thread_regs_invalidate(rtos);
+
 	if (rtos->thread_details) {
 		int j;
 
@@ -721,7 +873,17 @@ int rtos_read_buffer(struct target *target, target_addr_t address,
 int rtos_write_buffer(struct target *target, target_addr_t address,
 		uint32_t size, const uint8_t *buffer)
 {
-	if (target->rtos->type->write_buffer)
+	if (target->rtos->type->write_buffer) {
+		rtos_memory_written(target);
 		return target->rtos->type->write_buffer(target->rtos, address, size, buffer);
+	}
 	return ERROR_NOT_IMPLEMENTED;
 }
+
+/* The cached thread registers may come from stack frames in the memory that
+ * was just written, e.g. when GDB edits the stacked registers of a task. */
+void rtos_memory_written(struct target *target)
+{
+	if (target->rtos && (target->rtos->thread_regs_count || target->rtos->thread_regs_fetched))
+		rtos_thread_regs_invalidate(target->rtos);
+}
@@ -33,6 +33,14 @@ struct thread_detail {
 	char *extra_info_str;
 };
 
+/** Register set of one thread, kept until the target resumes or its
+ * memory is written. */
+struct rtos_thread_regs {
+	threadid_t threadid;
+	struct rtos_reg *reg_list;
+	int num_regs;
+};
+
 struct rtos {
 	const struct rtos_type *type;
 
@@ -48,6 +56,10 @@ struct rtos {
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
+	/* Per-halt cache of thread register sets, see rtos_get_gdb_reg_list(). */
+	struct rtos_thread_regs *thread_regs;
+	int thread_regs_count;
+	bool thread_regs_fetched;
 };
 
 struct rtos_reg {
@@ -78,6 +90,9 @@ struct rtos_type {
 			uint8_t *buffer);
 	int (*write_buffer)(struct rtos *rtos, target_addr_t address, uint32_t size,
 			const uint8_t *buffer);
+	/* Thread registers are read from the target register caches, which can
+	 * be written at any time ('G' packet, 'reg' command): never cache them. */
+	bool live_thread_regs;
 };
 
 struct stack_register_offset {
@@ -135,6 +150,7 @@ int rtos_read_buffer(struct target *target, target_addr_t address,
 		uint32_t size, uint8_t *buffer);
 int rtos_write_buffer(struct target *target, target_addr_t address,
 		uint32_t size, const uint8_t *buffer);
+void rtos_memory_written(struct target *target);
 
 extern const struct rtos_type chibios_rtos;
 extern const struct rtos_type chromium_ec_rtos;
@@ -14,6 +14,7 @@
 
 #include <helper/log.h>
 #include <helper/list.h>
+#include <helper/metrics.h>
 #include <target/target.h>
 #include <target/rtt.h>
 
@@ -293,8 +294,13 @@ int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		return ERROR_OK;
 	}
 
-	return rtt.source.write(rtt.target, &rtt.ctrl, channel_index, buffer,
+	int ret = rtt.source.write(rtt.target, &rtt.ctrl, channel_index, buffer,
 		length, NULL);
+
+	if (ret == ERROR_OK)
+		metrics_add(METRICS_RTT_BYTES, "dir=\"down\"", *length);
+
+	return ret;
 }
 
 bool rtt_started(void)
@@ -37,6 +37,7 @@
 #include <flash/nor/core.h>
 #include "gdb_server.h"
 #include <target/image.h>
+#include <helper/metrics.h>
 #include <jtag/jtag.h>
 #include "rtos/rtos.h"
 #include "target/smp.h"
@@ -72,6 +73,12 @@ struct gdb_connection {
 	bool ctrl_c;
 	enum target_state frontend_state;
 	struct image *vflash_image;
+	/* programming of the vFlashWrite data has started */
+	bool vflash_writing;
+	/* bytes of the vFlashWrite data already programmed */
+	uint32_t vflash_written;
+	/* the vFlashWrite data below this address is already programmed */
+	target_addr_t vflash_boundary;
 	bool closed;
 	/* set to prevent re-entrance from log messages during gdb_get_packet()
 	 * and gdb_put_packet(). */
@@ -992,6 +999,9 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->ctrl_c = false;
 	gdb_connection->frontend_state = TARGET_HALTED;
 	gdb_connection->vflash_image = NULL;
+	gdb_connection->vflash_writing = false;
+	gdb_connection->vflash_written = 0;
+	gdb_connection->vflash_boundary = 0;
 	gdb_connection->closed = false;
 	gdb_connection->busy = false;
 	gdb_connection->noack_mode = 0;
@@ -1089,6 +1099,18 @@ static int gdb_new_connection(struct connection *connection)
 	return ERROR_OK;
 }
 
+static void gdb_vflash_free(struct gdb_connection *gdb_connection)
+{
+	if (gdb_connection->vflash_image) {
+		image_close(gdb_connection->vflash_image);
+		free(gdb_connection->vflash_image);
+		gdb_connection->vflash_image = NULL;
+	}
+	gdb_connection->vflash_writing = false;
+	gdb_connection->vflash_written = 0;
+	gdb_connection->vflash_boundary = 0;
+}
+
 static int gdb_connection_closed(struct connection *connection)
 {
 	struct target *target;
@@ -1108,11 +1130,9 @@ static int gdb_connection_closed(struct connection *connection)
 		gdb_actual_connections);
 
 	/* see if an image built with vFlash commands is left */
-	if (gdb_connection->vflash_image) {
-		image_close(gdb_connection->vflash_image);
-		free(gdb_connection->vflash_image);
-		gdb_connection->vflash_image = NULL;
-	}
+	if (gdb_connection->vflash_writing)
+		target_call_event_callbacks(target, TARGET_EVENT_GDB_FLASH_WRITE_END);
+	gdb_vflash_free(gdb_connection);
 
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
@@ -3251,6 +3271,125 @@ static bool gdb_handle_vrun_packet(struct connection *connection, const char *pa
 	return true;
 }
 
+/* vFlashWrite data of completed sectors is programmed as soon as this much
+ * of it is buffered, while GDB is still sending the rest of the image. */
+#define GDB_VFLASH_CHUNK	(64 * 1024)
+
+/* Program the buffered vFlashWrite data below @a boundary and keep the rest
+ * buffered. The boundary is sector aligned, so no write block is programmed
+ * twice. */
+static int gdb_vflash_write(struct connection *connection, target_addr_t boundary)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	struct image *image = gdb_connection->vflash_image;
+	uint32_t written;
+	int retval;
+
+	struct image *keep = malloc(sizeof(*keep));
+	if (!keep) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	image_open(keep, "", "build");
+
+	/* move the data at and above the boundary to a new image */
+	unsigned int num_sections = 0;
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		uint8_t *data = section->private;
+
+		if (section->base_address >= boundary) {
+			retval = image_add_section(keep, section->base_address, section->size,
+				section->flags, data);
+			section->size = 0;
+		} else if (section->base_address + section->size > boundary) {
+			uint32_t below = boundary - section->base_address;
+			retval = image_add_section(keep, boundary, section->size - below,
+				section->flags, data + below);
+			section->size = below;
+		} else {
+			retval = ERROR_OK;
+		}
+
+		if (retval != ERROR_OK) {
+			image_close(keep);
+			free(keep);
+			return retval;
+		}
+
+		/* keep the sections left to program in front */
+		if (section->size) {
+			struct imagesection tmp = image->sections[num_sections];
+			image->sections[num_sections] = *section;
+			*section = tmp;
+			num_sections++;
+		}
+	}
+
+	/* hide the emptied sections from flash_write(), image_close() still
+	 * releases their data */
+	unsigned int total_sections = image->num_sections;
+	image->num_sections = num_sections;
+
+	retval = ERROR_OK;
+	if (num_sections) {
+		if (!gdb_connection->vflash_writing) {
+			target_call_event_callbacks(target, TARGET_EVENT_GDB_FLASH_WRITE_START);
+			gdb_connection->vflash_writing = true;
+		}
+
+		retval = flash_write(target, image, &written, false);
+		if (retval == ERROR_OK)
+			gdb_connection->vflash_written += written;
+	}
+
+	image->num_sections = total_sections;
+	image_close(image);
+	free(image);
+	gdb_connection->vflash_image = keep;
+	gdb_connection->vflash_boundary = MAX(gdb_connection->vflash_boundary, boundary);
+
+	return retval;
+}
+
+/* Called after each vFlashWrite: program the sectors GDB is done with once
+ * enough of them are buffered. GDB sends the data in ascending address
+ * order, so everything below the sector of the latest packet is complete.
+ * The vFlashWrite handler rejects data below the programmed boundary. */
+static int gdb_vflash_stream(struct connection *connection, target_addr_t addr)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	struct image *image = gdb_connection->vflash_image;
+	struct flash_bank *bank;
+
+	int retval = get_flash_bank_by_addr(target, addr, false, &bank);
+	if (retval != ERROR_OK || !bank || !bank->num_sectors)
+		return ERROR_OK;
+
+	target_addr_t boundary = addr;
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		target_addr_t start = bank->base + bank->sectors[i].offset;
+		if (addr >= start && addr < start + bank->sectors[i].size) {
+			boundary = start;
+			break;
+		}
+	}
+
+	uint64_t pending = 0;
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		if (section->base_address < boundary)
+			pending += MIN(section->size, boundary - section->base_address);
+	}
+
+	if (pending < GDB_VFLASH_CHUNK)
+		return ERROR_OK;
+
+	return gdb_vflash_write(connection, boundary);
+}
+
 static int gdb_v_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -3363,6 +3502,20 @@ static int gdb_v_packet(struct connection *connection,
 		}
 		length = packet_size - (parse - packet);
 
+		/* the sectors below the boundary are programmed already, writing
+		 * them again would corrupt the flash */
+		if (addr < gdb_connection->vflash_boundary) {
+			LOG_ERROR("vFlashWrite at " TARGET_ADDR_FMT " below the programmed data at "
+				TARGET_ADDR_FMT ", out of order flash writes are not supported",
+				addr, gdb_connection->vflash_boundary);
+			if (gdb_connection->vflash_writing)
+				target_call_event_callbacks(target,
+					TARGET_EVENT_GDB_FLASH_WRITE_END);
+			gdb_vflash_free(gdb_connection);
+			gdb_send_error(connection, EIO);
+			return ERROR_OK;
+		}
+
 		/* create a new image if there isn't already one */
 		if (!gdb_connection->vflash_image) {
 			gdb_connection->vflash_image = malloc(sizeof(struct image));
@@ -3375,14 +3528,26 @@ static int gdb_v_packet(struct connection *connection,
 		if (retval != ERROR_OK)
 			return retval;
 
+		/* program the completed sectors while GDB sends the next packets */
+		result = gdb_vflash_stream(connection, addr);
+		if (result != ERROR_OK) {
+			if (gdb_connection->vflash_writing)
+				target_call_event_callbacks(target,
+					TARGET_EVENT_GDB_FLASH_WRITE_END);
+			gdb_vflash_free(gdb_connection);
+			if (result == ERROR_FLASH_DST_OUT_OF_BANK)
+				gdb_put_packet(connection, "E.memtype", 9);
+			else
+				gdb_send_error(connection, EIO);
+			return ERROR_OK;
+		}
+
 		gdb_put_packet(connection, "OK", 2);
 
 		return ERROR_OK;
 	}
 
 	if (strncmp(packet, "vFlashDone", 10) == 0) {
-		uint32_t written;
-
 		/* GDB command 'flash-erase' does not send a vFlashWrite,
 		 * so nothing to write here. */
 		if (!gdb_connection->vflash_image) {
@@ -3390,27 +3555,24 @@ static int gdb_v_packet(struct connection *connection,
 			return ERROR_OK;
 		}
 
-		/* process the flashing buffer. No need to erase as GDB
-		 * always issues a vFlashErase first. */
-		target_call_event_callbacks(target,
-				TARGET_EVENT_GDB_FLASH_WRITE_START);
-		result = flash_write(target, gdb_connection->vflash_image,
-			&written, false);
-		target_call_event_callbacks(target,
-			TARGET_EVENT_GDB_FLASH_WRITE_END);
+		/* process the rest of the flashing buffer. No need to erase
+		 * as GDB always issues a vFlashErase first. */
+		result = gdb_vflash_write(connection, (target_addr_t)-1);
+		if (gdb_connection->vflash_writing)
+			target_call_event_callbacks(target,
+				TARGET_EVENT_GDB_FLASH_WRITE_END);
 		if (result != ERROR_OK) {
 			if (result == ERROR_FLASH_DST_OUT_OF_BANK)
 				gdb_put_packet(connection, "E.memtype", 9);
 			else
 				gdb_send_error(connection, EIO);
 		} else {
-			LOG_DEBUG("wrote %u bytes from vFlash image to flash", (unsigned)written);
+			LOG_DEBUG("wrote %u bytes from vFlash image to flash",
+				(unsigned)gdb_connection->vflash_written);
 			gdb_put_packet(connection, "OK", 2);
 		}
 
-		image_close(gdb_connection->vflash_image);
-		free(gdb_connection->vflash_image);
-		gdb_connection->vflash_image = NULL;
+		gdb_vflash_free(gdb_connection);
 
 		return ERROR_OK;
 	}
@@ -3503,6 +3665,36 @@ static void gdb_sig_halted(struct connection *connection)
 	gdb_put_packet(connection, sig_reply, 3);
 }
 
+/* Account the handling time of a packet to its type: the first character,
+ * or the name up to the first separator for 'q', 'Q' and 'v' packets. */
+static void gdb_packet_metrics(const char *packet, const struct duration *packet_time)
+{
+	if (metrics_enabled) {
+		char labels[32];
+		char type[17];
+		size_t len = 1;
+
+		if (packet[0] == 'q' || packet[0] == 'Q' || packet[0] == 'v')
+			while (len < sizeof(type) - 1 && isalnum((unsigned char)packet[len]))
+				len++;
+
+		for (size_t i = 0; i < len; i++)
+			type[i] = (isgraph((unsigned char)packet[i]) && packet[i] != '"' && packet[i] != '\\') ?
+				packet[i] : '_';
+		type[len] = '\0';
+
+		snprintf(labels, sizeof(labels), "type=\"%s\"", type);
+		metrics_observe(METRICS_GDB_PACKET_SECONDS, labels, packet_time);
+	}
+
+	uint8_t head[4] = { 0 };
+	for (size_t i = 0; i < sizeof(head) && packet[i]; i++)
+		head[i] = packet[i];
+	log_trace(LOG_TRACE_GDB_PACKET,
+		packet_time->elapsed.tv_sec * 1000000 + packet_time->elapsed.tv_usec,
+		le_to_h_u32(head));
+}
+
 static int gdb_input_inner(struct connection *connection)
 {
 	/* Do not allocate this on the stack */
@@ -3538,8 +3730,10 @@ static int gdb_input_inner(struct connection *connection)
 		gdb_packet_buffer[packet_size] = '\0';
 
 		if (packet_size > 0) {
+			struct duration packet_time;
 
 			gdb_log_incoming_packet(connection, gdb_packet_buffer);
+			duration_start(&packet_time);
 
 			retval = ERROR_OK;
 			switch (packet[0]) {
@@ -3723,6 +3917,9 @@ static int gdb_input_inner(struct connection *connection)
 					break;
 			}
 
+			if (duration_measure(&packet_time) == ERROR_OK)
+				gdb_packet_metrics(packet, &packet_time);
+
 			/* if a packet handler returned an error, exit input loop */
 			if (retval != ERROR_OK)
 				return retval;
@@ -19,11 +19,14 @@
 #define IPDBG_MAX_NUM_OF_CREATE_OPTIONS 10
 #define IPDBG_NUM_OF_START_OPTIONS 4
 #define IPDBG_NUM_OF_STOP_OPTIONS 2
-#define IPDBG_NUM_OF_QUEUE_OPTIONS 2
+#define IPDBG_MIN_NUM_OF_QUEUE_OPTIONS 2
+#define IPDBG_MAX_NUM_OF_QUEUE_OPTIONS 4
 #define IPDBG_MIN_DR_LENGTH 11
 #define IPDBG_MAX_DR_LENGTH 13
 #define IPDBG_TCP_PORT_STR_MAX_LENGTH 6
 #define IPDBG_SCRATCH_MEMORY_SIZE 1024
+#define IPDBG_MIN_UP_SCANS 16
+#define IPDBG_MAX_BURST_MS 50
 
 /* private connection data for IPDBG */
 struct ipdbg_fifo {
@@ -57,6 +60,8 @@ struct ipdbg_hub_scratch_memory {
 	uint8_t *dr_in_vals;
 	uint8_t *vir_out_val;
 	struct scan_field *fields;
+	/* tool of each queued dr scan, max_tools for empty scans */
+	uint8_t *slot_tools;
 };
 
 struct ipdbg_hub {
@@ -70,6 +75,13 @@ struct ipdbg_hub {
 	uint32_t last_dn_tool;
 	char *name;
 	size_t using_queue_size;
+	/* dn bytes sent per flush to a tool with flow control */
+	size_t flow_control_window;
+	/* number of empty scans per poll round, adapted to the up traffic */
+	size_t up_scans;
+	/* the hub selection is kept while no other queue flush happened */
+	bool selected;
+	int flush_count;
 	struct ipdbg_hub *next;
 	struct jtag_tap *tap;
 	struct connection **connections;
@@ -276,6 +288,7 @@ static void ipdbg_free_hub(struct ipdbg_hub *hub)
 	free(hub->scratch_memory.dr_out_vals);
 	free(hub->scratch_memory.dr_in_vals);
 	free(hub->scratch_memory.fields);
+	free(hub->scratch_memory.slot_tools);
 	free(hub->scratch_memory.vir_out_val);
 	free(hub);
 }
@@ -304,6 +317,7 @@ static struct ipdbg_hub *ipdbg_allocate_hub(uint8_t data_register_length, struct
 	new_hub->scratch_memory.dr_out_vals = calloc(IPDBG_SCRATCH_MEMORY_SIZE, dreg_buffer_size);
 	new_hub->scratch_memory.dr_in_vals = calloc(IPDBG_SCRATCH_MEMORY_SIZE, dreg_buffer_size);
 	new_hub->scratch_memory.fields = calloc(IPDBG_SCRATCH_MEMORY_SIZE, sizeof(struct scan_field));
+	new_hub->scratch_memory.slot_tools = calloc(IPDBG_SCRATCH_MEMORY_SIZE, sizeof(uint8_t));
 	new_hub->connections = calloc(max_tools, sizeof(struct connection *));
 
 	if (virtual_ir) {
@@ -312,7 +326,7 @@ static struct ipdbg_hub *ipdbg_allocate_hub(uint8_t data_register_length, struct
 	}
 
 	if (!new_hub->scratch_memory.dr_out_vals || !new_hub->scratch_memory.dr_in_vals ||
-		!new_hub->scratch_memory.fields || (virtual_ir && !new_hub->scratch_memory.vir_out_val) ||
+		!new_hub->scratch_memory.fields || !new_hub->scratch_memory.slot_tools || (virtual_ir && !new_hub->scratch_memory.vir_out_val) ||
 		!new_hub->connections) {
 		ipdbg_free_hub(new_hub);
 		LOG_ERROR("Out of memory");
@@ -331,14 +345,19 @@ static void ipdbg_init_scan_field(struct scan_field *fields, uint8_t *in_value,
 	fields->out_value = out_value;
 }
 
-static int ipdbg_shift_instr(struct ipdbg_hub *hub, uint32_t instr)
+/* The hub stays selected while nobody else flushed the JTAG queue since our
+ * last flush and the instruction register still holds the user instruction. */
+static bool ipdbg_hub_is_selected(struct ipdbg_hub *hub)
 {
-	if (!hub)
-		return ERROR_FAIL;
+	struct jtag_tap *tap = hub->tap;
 
+	return hub->selected && hub->flush_count == jtag_get_flush_queue_count() &&
+		buf_get_u32(tap->cur_instr, 0, tap->ir_length) == hub->user_instruction;
+}
+
+static int ipdbg_queue_instr(struct ipdbg_hub *hub, uint32_t instr)
+{
 	struct jtag_tap *tap = hub->tap;
-	if (!tap)
-		return ERROR_FAIL;
 
 	if (buf_get_u32(tap->cur_instr, 0, tap->ir_length) == instr) {
 		/* there is already the requested instruction in the ir */
@@ -352,55 +371,64 @@ static int ipdbg_shift_instr(struct ipdbg_hub *hub, uint32_t instr)
 	}
 	buf_set_u32(ir_out_val, 0, tap->ir_length, instr);
 
+	/* the scan is copied into the queue */
 	struct scan_field fields;
 	ipdbg_init_scan_field(&fields, NULL, tap->ir_length, ir_out_val);
 	jtag_add_ir_scan(tap, &fields, TAP_IDLE);
-	int retval = jtag_execute_queue();
 
 	free(ir_out_val);
 
-	return retval;
+	return ERROR_OK;
 }
 
-static int ipdbg_shift_vir(struct ipdbg_hub *hub)
+/* Queue the vir and ir scans selecting the hub in front of the data scans,
+ * unless the hub is still selected from the previous flush. */
+static int ipdbg_queue_select(struct ipdbg_hub *hub)
 {
-	if (!hub)
+	if (!hub || !hub->tap)
 		return ERROR_FAIL;
 
-	if (!hub->virtual_ir)
+	if (ipdbg_hub_is_selected(hub))
 		return ERROR_OK;
 
-	int retval = ipdbg_shift_instr(hub, hub->virtual_ir->instruction);
-	if (retval != ERROR_OK)
-		return retval;
+	if (hub->virtual_ir) {
+		int retval = ipdbg_queue_instr(hub, hub->virtual_ir->instruction);
+		if (retval != ERROR_OK)
+			return retval;
 
-	struct jtag_tap *tap = hub->tap;
-	if (!tap)
-		return ERROR_FAIL;
+		struct scan_field field;
+		ipdbg_init_scan_field(&field, NULL, hub->virtual_ir->length,
+			hub->scratch_memory.vir_out_val);
+		jtag_add_dr_scan(hub->tap, 1, &field, TAP_IDLE);
+	}
 
-	ipdbg_init_scan_field(hub->scratch_memory.fields, NULL,
-		hub->virtual_ir->length, hub->scratch_memory.vir_out_val);
-	jtag_add_dr_scan(tap, 1, hub->scratch_memory.fields, TAP_IDLE);
-	retval = jtag_execute_queue();
+	hub->selected = true;
+	return ipdbg_queue_instr(hub, hub->user_instruction);
+}
+
+static int ipdbg_execute_queue(struct ipdbg_hub *hub)
+{
+	int retval = jtag_execute_queue();
+
+	if (retval != ERROR_OK)
+		hub->selected = false;
+	hub->flush_count = jtag_get_flush_queue_count();
 
 	return retval;
 }
 
 static int ipdbg_shift_data(struct ipdbg_hub *hub, uint32_t dn_data, uint32_t *up_data)
 {
-	if (!hub)
-		return ERROR_FAIL;
-
-	struct jtag_tap *tap = hub->tap;
-	if (!tap)
-		return ERROR_FAIL;
+	int retval = ipdbg_queue_select(hub);
+	if (retval != ERROR_OK)
+		return retval;
 
 	buf_set_u32(hub->scratch_memory.dr_out_vals, 0, hub->data_register_length, dn_data);
 
 	ipdbg_init_scan_field(hub->scratch_memory.fields, hub->scratch_memory.dr_in_vals,
 						hub->data_register_length, hub->scratch_memory.dr_out_vals);
-	jtag_add_dr_scan(tap, 1, hub->scratch_memory.fields, TAP_IDLE);
-	int retval = jtag_execute_queue();
+	jtag_add_dr_scan(hub->tap, 1, hub->scratch_memory.fields, TAP_IDLE);
+	retval = ipdbg_execute_queue(hub);
 
 	if (up_data && retval == ERROR_OK)
 		*up_data = buf_get_u32(hub->scratch_memory.dr_in_vals, 0, hub->data_register_length);
@@ -446,153 +474,116 @@ static void ipdbg_check_for_xoff(struct ipdbg_hub *hub, size_t tool,
 	hub->last_dn_tool = tool;
 }
 
-static int ipdbg_shift_empty_data(struct ipdbg_hub *hub)
+/* Queue a dr scan in @a slot of the scratch memory, sending @a dn_data for @a tool.
+ * Empty scans use tool max_tools. */
+static void ipdbg_queue_data(struct ipdbg_hub *hub, size_t slot, size_t tool, uint32_t dn_data)
 {
-	if (!hub)
-		return ERROR_FAIL;
-
-	struct jtag_tap *tap = hub->tap;
-	if (!tap)
-		return ERROR_FAIL;
-
 	const size_t dreg_buffer_size = DIV_ROUND_UP(hub->data_register_length, 8);
-	memset(hub->scratch_memory.dr_out_vals, 0, dreg_buffer_size);
-	for (size_t i = 0; i < hub->using_queue_size; ++i) {
-		ipdbg_init_scan_field(hub->scratch_memory.fields + i,
-								hub->scratch_memory.dr_in_vals + i * dreg_buffer_size,
-								hub->data_register_length,
-								hub->scratch_memory.dr_out_vals);
-		jtag_add_dr_scan(tap, 1, hub->scratch_memory.fields + i, TAP_IDLE);
-	}
-
-	int retval = jtag_execute_queue();
-
-	if (retval == ERROR_OK) {
-		uint32_t up_data;
-		for (size_t i = 0; i < hub->using_queue_size; ++i) {
-			up_data = buf_get_u32(hub->scratch_memory.dr_in_vals +
-									i * dreg_buffer_size, 0,
-									hub->data_register_length);
-			int rv = ipdbg_distribute_data_from_hub(hub, up_data);
-			if (rv != ERROR_OK)
-				retval = rv;
-
-			if (i == 0) {
-				/* check if xoff sent is only needed on the first transfer which
-				   may contain the xoff of the prev down transfer.
-				*/
-				ipdbg_check_for_xoff(hub, hub->max_tools, up_data);
-			}
-		}
-	}
-
-	return retval;
+	uint8_t *out = hub->scratch_memory.dr_out_vals + slot * dreg_buffer_size;
+
+	buf_set_u32(out, 0, hub->data_register_length, dn_data);
+	ipdbg_init_scan_field(hub->scratch_memory.fields + slot,
+						hub->scratch_memory.dr_in_vals + slot * dreg_buffer_size,
+						hub->data_register_length, out);
+	jtag_add_dr_scan(hub->tap, 1, hub->scratch_memory.fields + slot, TAP_IDLE);
+	hub->scratch_memory.slot_tools[slot] = tool;
 }
 
-static int ipdbg_jtag_transfer_byte(struct ipdbg_hub *hub, size_t tool, struct ipdbg_connection *connection)
+/* One poll round: the hub selection, the dn data of all tools and some empty
+ * scans to fetch up data all go out in a single queue flush. Channels with
+ * flow control send at most flow_control_window bytes per round, the hub
+ * reports xoff only one scan after the byte it refers to.
+ * Returns the number of valid up bytes received in @a up_count. */
+static int ipdbg_poll_round(struct ipdbg_hub *hub, size_t *up_count)
 {
-	uint32_t dn = hub->valid_mask | ((tool & hub->tool_mask) << 8) |
-				(0x00fful & ipdbg_get_from_fifo(&connection->dn_fifo));
-	uint32_t up = 0;
-	int ret = ipdbg_shift_data(hub, dn, &up);
-	if (ret != ERROR_OK)
-		return ret;
-
-	ret = ipdbg_distribute_data_from_hub(hub, up);
-	if (ret != ERROR_OK)
-		return ret;
+	const size_t dreg_buffer_size = DIV_ROUND_UP(hub->data_register_length, 8);
+	size_t num_scans = 0;
 
-	ipdbg_check_for_xoff(hub, tool, up);
+	*up_count = 0;
 
-	return ERROR_OK;
-}
+	int retval = ipdbg_queue_select(hub);
+	if (retval != ERROR_OK)
+		return retval;
 
-static int ipdbg_jtag_transfer_bytes(struct ipdbg_hub *hub,
-			size_t tool, struct ipdbg_connection *connection)
-{
-	if (!hub)
-		return ERROR_FAIL;
+	for (size_t tool = 0; tool < hub->max_tools; ++tool) {
+		struct connection *conn = hub->connections[tool];
+		if (!conn || !conn->priv || (hub->dn_xoff & BIT(tool)))
+			continue;
 
-	struct jtag_tap *tap = hub->tap;
-	if (!tap)
-		return ERROR_FAIL;
+		struct ipdbg_connection *connection = conn->priv;
+		size_t num_tx = MIN(connection->dn_fifo.count, hub->using_queue_size - num_scans);
+		if (hub->flow_control_enabled & BIT(tool))
+			num_tx = MIN(num_tx, hub->flow_control_window);
 
-	const size_t dreg_buffer_size = DIV_ROUND_UP(hub->data_register_length, 8);
-	size_t num_tx = (connection->dn_fifo.count < hub->using_queue_size) ?
-		connection->dn_fifo.count : hub->using_queue_size;
-
-	for (size_t i = 0; i < num_tx; ++i) {
-		uint32_t dn_data = hub->valid_mask | ((tool & hub->tool_mask) << 8) |
-			(0x00fful & ipdbg_get_from_fifo(&connection->dn_fifo));
-		buf_set_u32(hub->scratch_memory.dr_out_vals + i * dreg_buffer_size, 0,
-					hub->data_register_length, dn_data);
-
-		ipdbg_init_scan_field(hub->scratch_memory.fields + i,
-								hub->scratch_memory.dr_in_vals +
-									i * dreg_buffer_size,
-								hub->data_register_length,
-								hub->scratch_memory.dr_out_vals +
-									i * dreg_buffer_size);
-		jtag_add_dr_scan(tap, 1, hub->scratch_memory.fields + i, TAP_IDLE);
+		for (size_t i = 0; i < num_tx; ++i) {
+			uint32_t dn_data = hub->valid_mask | ((tool & hub->tool_mask) << 8) |
+				(0x00fful & ipdbg_get_from_fifo(&connection->dn_fifo));
+			ipdbg_queue_data(hub, num_scans++, tool, dn_data);
+		}
 	}
 
-	int retval = jtag_execute_queue();
+	/* some transfers to get data from jtag-hub, also carrying the xoff of the last dn byte */
+	size_t num_empty = MIN(hub->up_scans, hub->using_queue_size - num_scans);
+	if (num_empty == 0 && num_scans == 0)
+		num_empty = 1;
+	for (size_t i = 0; i < num_empty; ++i)
+		ipdbg_queue_data(hub, num_scans++, hub->max_tools, 0);
 
-	if (retval == ERROR_OK) {
-		uint32_t up_data;
-		for (size_t i = 0; i < num_tx; ++i) {
-			up_data = buf_get_u32(hub->scratch_memory.dr_in_vals +
-									i * dreg_buffer_size,
-									0, hub->data_register_length);
-			int rv = ipdbg_distribute_data_from_hub(hub, up_data);
-			if (rv != ERROR_OK)
-				retval = rv;
-			if (i == 0) {
-				/* check if xoff sent is only needed on the first transfer which
-				   may contain the xoff of the prev down transfer.
-				   No checks for this channel because this function is only
-				   called for channels without enabled flow control.
-				*/
-				ipdbg_check_for_xoff(hub, tool, up_data);
-			}
+	retval = ipdbg_execute_queue(hub);
+	if (retval != ERROR_OK)
+		return retval;
+
+	size_t empty_valid = 0;
+	for (size_t i = 0; i < num_scans; ++i) {
+		uint32_t up_data = buf_get_u32(hub->scratch_memory.dr_in_vals + i * dreg_buffer_size,
+								0, hub->data_register_length);
+		if (up_data & hub->valid_mask) {
+			(*up_count)++;
+			if (hub->scratch_memory.slot_tools[i] == hub->max_tools)
+				empty_valid++;
 		}
+
+		int rv = ipdbg_distribute_data_from_hub(hub, up_data);
+		if (rv != ERROR_OK)
+			retval = rv;
+
+		/* the xoff flag refers to the previous dn transfer */
+		ipdbg_check_for_xoff(hub, hub->scratch_memory.slot_tools[i], up_data);
 	}
 
+	/* adapt the number of empty scans to the up traffic */
+	if (num_empty && empty_valid * 2 >= num_empty)
+		hub->up_scans = MIN(hub->up_scans * 2, hub->using_queue_size);
+	else if (empty_valid == 0)
+		hub->up_scans = MAX(hub->up_scans / 2, MIN(IPDBG_MIN_UP_SCANS, hub->using_queue_size));
+
 	return retval;
 }
 
 static int ipdbg_polling_callback(void *priv)
 {
 	struct ipdbg_hub *hub = priv;
-
-	int ret = ipdbg_shift_vir(hub);
-	if (ret != ERROR_OK)
-		return ret;
-
-	ret = ipdbg_shift_instr(hub, hub->user_instruction);
-	if (ret != ERROR_OK)
-		return ret;
-
-	/* transfer dn buffers to jtag-hub */
-	for (size_t tool = 0; tool < hub->max_tools; ++tool) {
-		struct connection *conn = hub->connections[tool];
-		if (conn && conn->priv) {
-			struct ipdbg_connection *connection = conn->priv;
-			while (((hub->dn_xoff & BIT(tool)) == 0) && !ipdbg_fifo_is_empty(&connection->dn_fifo)) {
-				if (hub->flow_control_enabled & BIT(tool))
-					ret = ipdbg_jtag_transfer_byte(hub, tool, connection);
-				else
-					ret = ipdbg_jtag_transfer_bytes(hub, tool, connection);
-				if (ret != ERROR_OK)
-					return ret;
+	const int64_t start = timeval_ms();
+
+	/* drain bursts back-to-back, but return to the server loop in time */
+	while (true) {
+		size_t dn_pending = 0;
+		for (size_t tool = 0; tool < hub->max_tools; ++tool) {
+			struct connection *conn = hub->connections[tool];
+			if (conn && conn->priv && !(hub->dn_xoff & BIT(tool))) {
+				struct ipdbg_connection *connection = conn->priv;
+				dn_pending += connection->dn_fifo.count;
 			}
 		}
-	}
 
-	/* some transfers to get data from jtag-hub in case there is no dn data */
-	ret = ipdbg_shift_empty_data(hub);
-	if (ret != ERROR_OK)
-		return ret;
+		size_t up_count;
+		int ret = ipdbg_poll_round(hub, &up_count);
+		if (ret != ERROR_OK)
+			return ret;
+
+		if ((!up_count && !dn_pending) || timeval_ms() - start >= IPDBG_MAX_BURST_MS)
+			break;
+	}
 
 	/* write from up fifos to sockets */
 	for (size_t tool = 0; tool < hub->max_tools; ++tool) {
@@ -647,15 +638,10 @@ static int ipdbg_start_polling(struct ipdbg_service *service, struct connection
 
 	const uint32_t reset_hub = hub->valid_mask | ((hub->max_tools) << 8);
 
-	int ret = ipdbg_shift_vir(hub);
-	if (ret != ERROR_OK)
-		return ret;
-
-	ret = ipdbg_shift_instr(hub, hub->user_instruction);
-	if (ret != ERROR_OK)
-		return ret;
+	hub->selected = false;
+	hub->up_scans = MIN(IPDBG_MIN_UP_SCANS, hub->using_queue_size);
 
-	ret = ipdbg_shift_data(hub, reset_hub, NULL);
+	int ret = ipdbg_shift_data(hub, reset_hub, NULL);
 	hub->last_dn_tool = hub->tool_mask;
 	hub->dn_xoff = 0;
 	if (ret != ERROR_OK)
@@ -902,7 +888,8 @@ static const struct command_registration ipdbg_hostserver_subcommand_handlers[]
 	COMMAND_REGISTRATION_DONE
 };
 
-static COMMAND_HELPER(ipdbg_config_queuing, struct ipdbg_hub *hub, unsigned int size)
+static COMMAND_HELPER(ipdbg_config_queuing, struct ipdbg_hub *hub, unsigned int size,
+	unsigned int window)
 {
 	if (!hub)
 		return ERROR_FAIL;
@@ -917,7 +904,13 @@ static COMMAND_HELPER(ipdbg_config_queuing, struct ipdbg_hub *hub, unsigned int
 		return ERROR_COMMAND_ARGUMENT_INVALID;
 	}
 
+	if (window == 0) {
+		command_print(CMD, "flow control window out of range! Must be 0 < window");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
 	hub->using_queue_size = size;
+	hub->flow_control_window = window;
 	return ERROR_OK;
 }
 
@@ -925,21 +918,24 @@ COMMAND_HANDLER(handle_ipdbg_cfg_queuing_command)
 {
 	struct ipdbg_hub *hub = CMD_DATA;
 
-	unsigned int size;
+	unsigned int size = hub->using_queue_size;
+	unsigned int window = hub->flow_control_window;
 
-	if (CMD_ARGC != IPDBG_NUM_OF_QUEUE_OPTIONS)
+	if (CMD_ARGC < IPDBG_MIN_NUM_OF_QUEUE_OPTIONS || CMD_ARGC > IPDBG_MAX_NUM_OF_QUEUE_OPTIONS)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	for (unsigned int i = 0; i < CMD_ARGC; ++i) {
 		if (strcmp(CMD_ARGV[i], "-size") == 0) {
 			COMMAND_PARSE_ADDITIONAL_NUMBER(uint, i, size, "size");
+		} else if (strcmp(CMD_ARGV[i], "-window") == 0) {
+			COMMAND_PARSE_ADDITIONAL_NUMBER(uint, i, window, "window");
 		} else {
 			command_print(CMD, "Unknown argument: %s", CMD_ARGV[i]);
 			return ERROR_FAIL;
 		}
 	}
 
-	return CALL_COMMAND_HANDLER(ipdbg_config_queuing, hub, size);
+	return CALL_COMMAND_HANDLER(ipdbg_config_queuing, hub, size, window);
 }
 
 static const struct command_registration ipdbg_hub_subcommand_handlers[] = {
@@ -955,7 +951,7 @@ static const struct command_registration ipdbg_hub_subcommand_handlers[] = {
 		.handler = handle_ipdbg_cfg_queuing_command,
 		.mode = COMMAND_ANY,
 		.help = "configures queuing between IPDBG Host and Hub.",
-		.usage = "-size size",
+		.usage = "[-size size] [-window size]",
 	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -1003,6 +999,7 @@ static int ipdbg_create_hub(struct jtag_tap *tap, uint32_t user_instruction, uin
 	new_hub->last_dn_tool         = new_hub->tool_mask;
 	new_hub->max_tools            = ipdbg_max_tools_from_data_register_length(data_register_length);
 	new_hub->using_queue_size     = IPDBG_SCRATCH_MEMORY_SIZE;
+	new_hub->flow_control_window  = 1;
 
 	int retval = ipdbg_register_hub_command(new_hub, cmd);
 	if (retval != ERROR_OK) {
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/metrics.h>
+
+#include "metrics_server.h"
+
+/**
+ * @file
+ *
+ * Metrics server.
+ *
+ * Answers every request on the metrics port with a minimal HTTP response
+ * carrying the counters of helper/metrics.c in the Prometheus text format,
+ * then closes the connection. The counters are only collected while the
+ * server runs.
+ */
+
+#define METRICS_HTTP_HEADER \
+	"HTTP/1.0 200 OK\r\n" \
+	"Content-Type: text/plain; version=0.0.4\r\n" \
+	"Connection: close\r\n" \
+	"\r\n"
+
+static char *metrics_port;
+
+static int metrics_new_connection(struct connection *connection)
+{
+	return ERROR_OK;
+}
+
+static int metrics_input(struct connection *connection)
+{
+	char buf[1024];
+
+	int len = connection_read(connection, buf, sizeof(buf));
+	if (len <= 0) {
+		if (len < 0)
+			LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	/* The request itself is of no interest: any request gets the metrics page. */
+	char *page = metrics_format();
+	if (!page)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	if (connection_write(connection, METRICS_HTTP_HEADER, strlen(METRICS_HTTP_HEADER)) < 0
+			|| connection_write(connection, page, strlen(page)) < 0)
+		LOG_DEBUG("metrics: error writing to connection");
+
+	free(page);
+
+	return ERROR_SERVER_REMOTE_CLOSED;
+}
+
+static int metrics_connection_closed(struct connection *connection)
+{
+	return ERROR_OK;
+}
+
+static const struct service_driver metrics_service_driver = {
+	.name = "metrics",
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = metrics_new_connection,
+	.input_handler = metrics_input,
+	.connection_closed_handler = metrics_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+int metrics_server_init(void)
+{
+	if (strcmp(metrics_port, "disabled") == 0) {
+		LOG_DEBUG("metrics server disabled");
+		return ERROR_OK;
+	}
+
+	int retval = add_service(&metrics_service_driver, metrics_port, CONNECTION_LIMIT_UNLIMITED, NULL);
+	if (retval == ERROR_OK)
+		metrics_enabled = true;
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_metrics_port_command)
+{
+	return CALL_COMMAND_HANDLER(server_pipe_command, &metrics_port);
+}
+
+COMMAND_HANDLER(handle_metrics_show_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	char *page = metrics_format();
+	if (!page)
+		return ERROR_FAIL;
+
+	command_print_sameline(CMD, "%s", page);
+	free(page);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_metrics_reset_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	metrics_reset();
+
+	return ERROR_OK;
+}
+
+static const struct command_registration metrics_subcommand_handlers[] = {
+	{
+		.name = "port",
+		.handler = handle_metrics_port_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Specify port on which to serve the metrics page. "
+			"Read help on 'gdb port'.",
+		.usage = "[port_num]",
+	},
+	{
+		.name = "show",
+		.handler = handle_metrics_show_command,
+		.mode = COMMAND_ANY,
+		.help = "Print the metrics page",
+		.usage = "",
+	},
+	{
+		.name = "reset",
+		.handler = handle_metrics_reset_command,
+		.mode = COMMAND_ANY,
+		.help = "Clear all counters and histograms",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration metrics_command_handlers[] = {
+	{
+		.name = "metrics",
+		.mode = COMMAND_ANY,
+		.help = "metrics command group",
+		.usage = "",
+		.chain = metrics_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int metrics_server_register_commands(struct command_context *cmd_ctx)
+{
+	metrics_port = strdup("disabled");
+	return register_commands(cmd_ctx, NULL, metrics_command_handlers);
+}
+
+void metrics_service_free(void)
+{
+	free(metrics_port);
+	metrics_free();
+}
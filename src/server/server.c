@@ -23,6 +23,7 @@
 #include "openocd.h"
 #include "tcl_server.h"
 #include "telnet_server.h"
+#include "metrics_server.h"
 #include "ipdbg.h"
 
 #include <signal.h>
@@ -481,6 +482,8 @@ int server_loop(struct command_context *command_context)
 			else if (timeout_ms > polling_period)
 				timeout_ms = polling_period;
 			tv.tv_usec = timeout_ms * 1000;
+			/* Write out buffered log messages before going idle */
+			log_flush();
 			/* Only while we're sleeping we'll let others run */
 			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
 		}
@@ -692,6 +695,13 @@ int server_init(struct command_context *cmd_ctx)
 		return ret;
 	}
 
+	ret = metrics_server_init();
+
+	if (ret != ERROR_OK) {
+		remove_services();
+		return ret;
+	}
+
 	return ERROR_OK;
 }
 
@@ -714,6 +724,7 @@ void server_free(void)
 {
 	tcl_service_free();
 	telnet_service_free();
+	metrics_service_free();
 	jsp_service_free();
 	ipdbg_server_free();
 
@@ -841,6 +852,10 @@ int server_register_commands(struct command_context *cmd_ctx)
 	if (retval != ERROR_OK)
 		return retval;
 
+	retval = metrics_server_register_commands(cmd_ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return register_commands(cmd_ctx, NULL, server_command_handlers);
 }
 
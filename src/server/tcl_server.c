@@ -16,6 +16,7 @@
 #define TCL_SERVER_VERSION		"TCL Server 0.1"
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
+#define TCL_BINARY_MAX			(64*1024*1024)
 
 struct tcl_connection {
 	int tc_linedrop;
@@ -26,6 +27,13 @@ struct tcl_connection {
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	/* raw memory block of "tcl read_binary" or "tcl write_binary" */
+	uint8_t *tc_bin_buf;
+	uint32_t tc_bin_size;
+	uint32_t tc_bin_offset;
+	bool tc_bin_write;
+	struct target *tc_bin_target;
+	target_addr_t tc_bin_address;
 };
 
 static char *tcl_port;
@@ -160,6 +168,55 @@ static int tcl_new_connection(struct connection *connection)
 	return ERROR_OK;
 }
 
+static void tcl_binary_free(struct tcl_connection *tclc)
+{
+	free(tclc->tc_bin_buf);
+	tclc->tc_bin_buf = NULL;
+	tclc->tc_bin_size = 0;
+	tclc->tc_bin_offset = 0;
+	tclc->tc_bin_write = false;
+}
+
+/* write the payload of "tcl write_binary" to the target once complete */
+static int tcl_binary_write_check(struct connection *connection)
+{
+	struct tcl_connection *tclc = connection->priv;
+	char buf[64];
+
+	if (tclc->tc_bin_offset < tclc->tc_bin_size)
+		return ERROR_OK;
+
+	int retval = target_write_buffer(tclc->tc_bin_target, tclc->tc_bin_address,
+			tclc->tc_bin_size, tclc->tc_bin_buf);
+	if (retval != ERROR_OK)
+		snprintf(buf, sizeof(buf), "failed to write memory at " TARGET_ADDR_FMT "\x1a",
+				tclc->tc_bin_address);
+	else
+		snprintf(buf, sizeof(buf), "\x1a");
+
+	tcl_binary_free(tclc);
+
+	return tcl_output(connection, buf, strlen(buf));
+}
+
+/* receive the payload of "tcl write_binary" straight into its buffer */
+static int tcl_input_binary(struct connection *connection)
+{
+	struct tcl_connection *tclc = connection->priv;
+
+	int rlen = connection_read(connection, tclc->tc_bin_buf + tclc->tc_bin_offset,
+			tclc->tc_bin_size - tclc->tc_bin_offset);
+	if (rlen <= 0) {
+		if (rlen < 0)
+			LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	tclc->tc_bin_offset += rlen;
+
+	return tcl_binary_write_check(connection);
+}
+
 static int tcl_input(struct connection *connection)
 {
 	Jim_Interp *interp = (Jim_Interp *)connection->cmd_ctx->interp;
@@ -173,6 +230,13 @@ static int tcl_input(struct connection *connection)
 	char *tc_line_new;
 	int tc_line_size_new;
 
+	tclc = connection->priv;
+	if (!tclc)
+		return ERROR_CONNECTION_REJECTED;
+
+	if (tclc->tc_bin_write)
+		return tcl_input_binary(connection);
+
 	rlen = connection_read(connection, &in, sizeof(in));
 	if (rlen <= 0) {
 		if (rlen < 0)
@@ -180,12 +244,21 @@ static int tcl_input(struct connection *connection)
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
-	tclc = connection->priv;
-	if (!tclc)
-		return ERROR_CONNECTION_REJECTED;
-
 	/* push as much data into the line as possible */
 	for (i = 0; i < rlen; i++) {
+		/* start of a binary payload following "tcl write_binary" */
+		if (tclc->tc_bin_write) {
+			uint32_t n = MIN((uint32_t)(rlen - i), tclc->tc_bin_size - tclc->tc_bin_offset);
+			memcpy(tclc->tc_bin_buf + tclc->tc_bin_offset, &in[i], n);
+			tclc->tc_bin_offset += n;
+			i += n - 1;
+
+			retval = tcl_binary_write_check(connection);
+			if (retval != ERROR_OK)
+				return retval;
+			continue;
+		}
+
 		/* buffer the data */
 		tclc->tc_line[tclc->tc_lineoffset] = in[i];
 		if (tclc->tc_lineoffset + 1 < tclc->tc_line_size) {
@@ -230,13 +303,25 @@ static int tcl_input(struct connection *connection)
 #undef ESTR
 		} else {
 			tclc->tc_line[tclc->tc_lineoffset-1] = '\0';
-			command_run_line(connection->cmd_ctx, tclc->tc_line);
+			int line_retval = command_run_line(connection->cmd_ctx, tclc->tc_line);
+			/* the client expects no binary transfer after an error reply,
+			 * even if the error came from a later command of the line */
+			if (line_retval != ERROR_OK)
+				tcl_binary_free(tclc);
 			result = Jim_GetString(Jim_GetResult(interp), &reslen);
 			retval = tcl_output(connection, result, reslen);
 			if (retval != ERROR_OK)
 				return retval;
 			/* Always output ctrl-z as end of line to allow multiline results */
 			tcl_output(connection, "\x1a", 1);
+
+			/* raw data of "tcl read_binary" follows the reply */
+			if (tclc->tc_bin_buf && !tclc->tc_bin_write) {
+				retval = tcl_output(connection, tclc->tc_bin_buf, tclc->tc_bin_size);
+				tcl_binary_free(tclc);
+				if (retval != ERROR_OK)
+					return retval;
+			}
 		}
 
 		tclc->tc_lineoffset = 0;
@@ -253,6 +338,7 @@ static int tcl_closed(struct connection *connection)
 
 	/* cleanup connection context */
 	if (tclc) {
+		tcl_binary_free(tclc);
 		free(tclc->tc_line);
 		free(tclc);
 		connection->priv = NULL;
@@ -323,6 +409,93 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 	}
 }
 
+static struct tcl_connection *tcl_binary_prepare(struct command_invocation *cmd,
+		uint32_t count)
+{
+	struct connection *connection = CMD_CTX->output_handler_priv;
+
+	if (!connection || strcmp(connection->service->name, "tcl")) {
+		command_print(CMD, "%s: can only be called from the tcl server", CMD_NAME);
+		return NULL;
+	}
+
+	struct tcl_connection *tclc = connection->priv;
+	if (tclc->tc_bin_buf) {
+		command_print(CMD, "%s: a binary transfer is already pending", CMD_NAME);
+		return NULL;
+	}
+
+	if (count == 0 || count > TCL_BINARY_MAX) {
+		command_print(CMD, "%s: count must be between 1 and %d", CMD_NAME, TCL_BINARY_MAX);
+		return NULL;
+	}
+
+	tclc->tc_bin_buf = malloc(count);
+	if (!tclc->tc_bin_buf) {
+		command_print(CMD, "Out of memory");
+		return NULL;
+	}
+	tclc->tc_bin_size = count;
+	tclc->tc_bin_offset = 0;
+
+	return tclc;
+}
+
+COMMAND_HANDLER(handle_tcl_read_binary_command)
+{
+	target_addr_t address;
+	uint32_t count;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], count);
+
+	struct target *target = get_current_target(CMD_CTX);
+
+	struct tcl_connection *tclc = tcl_binary_prepare(CMD, count);
+	if (!tclc)
+		return ERROR_FAIL;
+
+	int retval = target_read_buffer(target, address, count, tclc->tc_bin_buf);
+	if (retval != ERROR_OK) {
+		tcl_binary_free(tclc);
+		command_print(CMD, "failed to read memory at " TARGET_ADDR_FMT, address);
+		return retval;
+	}
+
+	command_print(CMD, "%" PRIu32, count);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_tcl_write_binary_command)
+{
+	target_addr_t address;
+	uint32_t count;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], count);
+
+	struct target *target = get_current_target(CMD_CTX);
+
+	struct tcl_connection *tclc = tcl_binary_prepare(CMD, count);
+	if (!tclc)
+		return ERROR_FAIL;
+
+	tclc->tc_bin_write = true;
+	tclc->tc_bin_target = target;
+	tclc->tc_bin_address = address;
+
+	command_print(CMD, "%" PRIu32, count);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration tcl_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -347,6 +520,22 @@ static const struct command_registration tcl_subcommand_handlers[] = {
 		.help = "Target trace output",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "read_binary",
+		.handler = handle_tcl_read_binary_command,
+		.mode = COMMAND_EXEC,
+		.help = "Read a block of target memory and send it as raw data "
+			"after the reply",
+		.usage = "address count",
+	},
+	{
+		.name = "write_binary",
+		.handler = handle_tcl_write_binary_command,
+		.mode = COMMAND_EXEC,
+		.help = "Receive count bytes of raw data after the reply and "
+			"write them to target memory",
+		.usage = "address count",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -1754,6 +1754,7 @@ static void arc_reset_actionpoints(struct target *target)
 	struct breakpoint *next_b;
 	struct watchpoint *next_w;
 
+	breakpoint_index_clear(target);
 	while (target->breakpoints) {
 		next_b = target->breakpoints->next;
 		arc_remove_breakpoint(target, target->breakpoints);
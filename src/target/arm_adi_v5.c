@@ -1333,24 +1333,32 @@ static int dap_queue_read_reg(enum coresight_access_mode mode, struct adiv5_ap *
 	return mem_ap_read_u32(ap, component_base + reg, value);
 }
 
+/** Raw ID registers of a CoreSight component, see rtp_decode_cs_regs() */
+struct cs_component_ids {
+	uint32_t pid[5];
+	uint32_t cid[4];
+};
+
 /**
- * Read the CoreSight registers needed during ROM Table Parsing (RTP).
+ * Queue the reads of the CoreSight registers needed during ROM Table
+ * Parsing (RTP), without running the queue.
  *
  * @param mode           Method to access the component (AP or MEM-AP).
  * @param ap             Pointer to AP containing the component.
  * @param component_base On MEM-AP access method, base address of the component.
  * @param v              Pointer to the struct holding the value of registers.
+ * @param ids            Pointer to the raw ID registers, decoded into @a v
+ *                       by rtp_decode_cs_regs() once the queue has run.
  *
  * @return ERROR_OK on success, else a fault code.
  */
-static int rtp_read_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap,
-		target_addr_t component_base, struct cs_component_vals *v)
+static int rtp_queue_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap,
+		target_addr_t component_base, struct cs_component_vals *v,
+		struct cs_component_ids *ids)
 {
 	assert(IS_ALIGNED(component_base, ARM_CS_ALIGN));
-	assert(ap && v);
+	assert(ap && v && ids);
 
-	uint32_t cid0, cid1, cid2, cid3;
-	uint32_t pid0, pid1, pid2, pid3, pid4;
 	int retval = ERROR_OK;
 
 	v->ap = ap;
@@ -1375,26 +1383,58 @@ static int rtp_read_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap
 		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_C9_DEVTYPE, &v->devtype_memtype);
 
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR4, &pid4);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR4, &ids->pid[4]);
 
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR0, &pid0);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR0, &ids->pid[0]);
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR1, &pid1);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR1, &ids->pid[1]);
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR2, &pid2);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR2, &ids->pid[2]);
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR3, &pid3);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR3, &ids->pid[3]);
 
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR0, &cid0);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR0, &ids->cid[0]);
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR1, &cid1);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR1, &ids->cid[1]);
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR2, &cid2);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR2, &ids->cid[2]);
 	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR3, &cid3);
+		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR3, &ids->cid[3]);
 
+	return retval;
+}
+
+static void rtp_decode_cs_regs(struct cs_component_vals *v, const struct cs_component_ids *ids)
+{
+	v->cid = (ids->cid[3] & 0xff) << 24
+			| (ids->cid[2] & 0xff) << 16
+			| (ids->cid[1] & 0xff) << 8
+			| (ids->cid[0] & 0xff);
+	v->pid = (uint64_t)(ids->pid[4] & 0xff) << 32
+			| (ids->pid[3] & 0xff) << 24
+			| (ids->pid[2] & 0xff) << 16
+			| (ids->pid[1] & 0xff) << 8
+			| (ids->pid[0] & 0xff);
+}
+
+/**
+ * Read the CoreSight registers needed during ROM Table Parsing (RTP).
+ *
+ * @param mode           Method to access the component (AP or MEM-AP).
+ * @param ap             Pointer to AP containing the component.
+ * @param component_base On MEM-AP access method, base address of the component.
+ * @param v              Pointer to the struct holding the value of registers.
+ *
+ * @return ERROR_OK on success, else a fault code.
+ */
+static int rtp_read_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap,
+		target_addr_t component_base, struct cs_component_vals *v)
+{
+	struct cs_component_ids ids;
+
+	int retval = rtp_queue_cs_regs(mode, ap, component_base, v, &ids);
 	if (retval == ERROR_OK)
 		retval = dap_run(ap->dap);
 	if (retval != ERROR_OK) {
@@ -1402,15 +1442,7 @@ static int rtp_read_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap
 		return retval;
 	}
 
-	v->cid = (cid3 & 0xff) << 24
-			| (cid2 & 0xff) << 16
-			| (cid1 & 0xff) << 8
-			| (cid0 & 0xff);
-	v->pid = (uint64_t)(pid4 & 0xff) << 32
-			| (pid3 & 0xff) << 24
-			| (pid2 & 0xff) << 16
-			| (pid1 & 0xff) << 8
-			| (pid0 & 0xff);
+	rtp_decode_cs_regs(v, &ids);
 
 	return ERROR_OK;
 }
@@ -1835,9 +1867,22 @@ static int rtp_ops_rom_table_entry(const struct rtp_ops *ops,
  */
 #define CORESIGHT_COMPONENT_FOUND (1)
 
+/* ROM table entries, and the ID registers of the components they point
+ * to, are read in batches of this many entries per DAP queue run */
+#define ROM_TABLE_BATCH (32)
+
 static int rtp_ap(const struct rtp_ops *ops, struct adiv5_ap *ap, int depth);
 static int rtp_cs_component(enum coresight_access_mode mode, const struct rtp_ops *ops,
-		struct adiv5_ap *ap, target_addr_t dbgbase, bool *is_mem_ap, int depth);
+		struct adiv5_ap *ap, target_addr_t dbgbase, const struct cs_component_vals *prefetched,
+		bool *is_mem_ap, int depth);
+
+/* Per batch state of rtp_rom_loop() */
+struct rtp_rom_batch {
+	uint32_t romentry_low[ROM_TABLE_BATCH];
+	uint32_t romentry_high[ROM_TABLE_BATCH];
+	struct cs_component_vals v[ROM_TABLE_BATCH];
+	struct cs_component_ids ids[ROM_TABLE_BATCH];
+};
 
 static int rtp_rom_loop(enum coresight_access_mode mode, const struct rtp_ops *ops,
 		struct adiv5_ap *ap, target_addr_t base_address, int depth,
@@ -1849,76 +1894,138 @@ static int rtp_rom_loop(enum coresight_access_mode mode, const struct rtp_ops *o
 
 	assert(IS_ALIGNED(base_address, ARM_CS_ALIGN));
 
+	struct rtp_rom_batch *batch = malloc(sizeof(*batch));
+	if (!batch)
+		return ERROR_FAIL;
+
+	const unsigned int entry_size = width / 8;
 	unsigned int offset = 0;
-	while (max_entries--) {
-		uint64_t romentry;
-		uint32_t romentry_low, romentry_high;
-		target_addr_t component_base;
-		unsigned int saved_offset = offset;
-
-		int retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_low);
-		offset += 4;
-		if (retval == ERROR_OK && width == 64) {
-			retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_high);
-			offset += 4;
+	int retval = ERROR_OK;
+
+	while (max_entries) {
+		/* Read a batch of entries. Entries after the end of table are
+		 * still inside the ROM table and read back as zero. */
+		unsigned int count = MIN(max_entries, ROM_TABLE_BATCH);
+		max_entries -= count;
+
+		for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+			unsigned int entry_offset = offset + i * entry_size;
+
+			retval = dap_queue_read_reg(mode, ap, base_address, entry_offset,
+					&batch->romentry_low[i]);
+			if (retval == ERROR_OK && width == 64)
+				retval = dap_queue_read_reg(mode, ap, base_address, entry_offset + 4,
+						&batch->romentry_high[i]);
 		}
 		if (retval == ERROR_OK)
 			retval = dap_run(ap->dap);
 		if (retval != ERROR_OK) {
 			LOG_DEBUG("Failed read ROM table entry");
-			return retval;
+			break;
 		}
 
-		if (width == 64) {
-			romentry = (((uint64_t)romentry_high) << 32) | romentry_low;
-			component_base = base_address +
-				((((uint64_t)romentry_high) << 32) | (romentry_low & ARM_CS_ROMENTRY_OFFSET_MASK));
-		} else {
-			romentry = romentry_low;
-			/* "romentry" is signed */
-			component_base = base_address + (int32_t)(romentry_low & ARM_CS_ROMENTRY_OFFSET_MASK);
-			if (!is_64bit_ap(ap))
-				component_base = (uint32_t)component_base;
+		uint64_t romentry[ROM_TABLE_BATCH];
+		target_addr_t component_base[ROM_TABLE_BATCH];
+		unsigned int num_entries = count;
+
+		for (unsigned int i = 0; i < count; i++) {
+			uint32_t romentry_low = batch->romentry_low[i];
+
+			if (width == 64) {
+				uint32_t romentry_high = batch->romentry_high[i];
+
+				romentry[i] = (((uint64_t)romentry_high) << 32) | romentry_low;
+				component_base[i] = base_address +
+					((((uint64_t)romentry_high) << 32) | (romentry_low & ARM_CS_ROMENTRY_OFFSET_MASK));
+			} else {
+				romentry[i] = romentry_low;
+				/* "romentry" is signed */
+				component_base[i] = base_address + (int32_t)(romentry_low & ARM_CS_ROMENTRY_OFFSET_MASK);
+				if (!is_64bit_ap(ap))
+					component_base[i] = (uint32_t)component_base[i];
+			}
+
+			if (romentry[i] == 0) {
+				/* End of ROM table */
+				num_entries = i + 1;
+				break;
+			}
 		}
-		retval = rtp_ops_rom_table_entry(ops, retval, depth, saved_offset, romentry);
-		if (retval != ERROR_OK)
-			return retval;
 
-		if (romentry == 0) {
-			/* End of ROM table */
-			break;
+		/* Read the ID registers of all the components behind this
+		 * batch of entries at once. If any of them fails, e.g. in a
+		 * powered down domain, fall back to reading them one by one. */
+		bool prefetched = false;
+		if (mode == CS_ACCESS_MEM_AP && depth + 1 <= ROM_TABLE_MAX_DEPTH) {
+			unsigned int queued = 0;
+			int retval1 = ERROR_OK;
+
+			for (unsigned int i = 0; i < num_entries && retval1 == ERROR_OK; i++) {
+				if (!(romentry[i] & ARM_CS_ROMENTRY_PRESENT))
+					continue;
+				retval1 = rtp_queue_cs_regs(mode, ap, component_base[i],
+						&batch->v[i], &batch->ids[i]);
+				queued++;
+			}
+			if (retval1 == ERROR_OK && queued)
+				retval1 = dap_run(ap->dap);
+			if (retval1 == ERROR_OK && queued) {
+				for (unsigned int i = 0; i < num_entries; i++)
+					if (romentry[i] & ARM_CS_ROMENTRY_PRESENT)
+						rtp_decode_cs_regs(&batch->v[i], &batch->ids[i]);
+				prefetched = true;
+			} else if (retval1 != ERROR_OK) {
+				LOG_DEBUG("Failed batch read of CoreSight registers, reading one by one");
+			}
 		}
 
-		if (!(romentry & ARM_CS_ROMENTRY_PRESENT))
-			continue;
+		for (unsigned int i = 0; i < num_entries; i++) {
+			retval = rtp_ops_rom_table_entry(ops, ERROR_OK, depth, offset, romentry[i]);
+			offset += entry_size;
+			if (retval != ERROR_OK)
+				goto done;
+
+			if (romentry[i] == 0) {
+				/* End of ROM table */
+				goto done;
+			}
+
+			if (!(romentry[i] & ARM_CS_ROMENTRY_PRESENT))
+				continue;
 
-		/* Recurse */
-		if (mode == CS_ACCESS_AP) {
-			struct adiv5_ap *next_ap = dap_get_ap(ap->dap, component_base);
-			if (!next_ap) {
-				LOG_DEBUG("Wrong AP # 0x%" PRIx64, component_base);
+			/* Recurse */
+			if (mode == CS_ACCESS_AP) {
+				struct adiv5_ap *next_ap = dap_get_ap(ap->dap, component_base[i]);
+				if (!next_ap) {
+					LOG_DEBUG("Wrong AP # 0x%" PRIx64, component_base[i]);
+					continue;
+				}
+				retval = rtp_ap(ops, next_ap, depth + 1);
+				dap_put_ap(next_ap);
+			} else {
+				/* mode == CS_ACCESS_MEM_AP */
+				retval = rtp_cs_component(mode, ops, ap, component_base[i],
+						prefetched ? &batch->v[i] : NULL, NULL, depth + 1);
+			}
+			if (retval == CORESIGHT_COMPONENT_FOUND)
+				goto done;
+			if (retval != ERROR_OK) {
+				/* TODO: do we need to send an ABORT before continuing? */
+				LOG_DEBUG("Ignore error parsing CoreSight component");
+				retval = ERROR_OK;
 				continue;
 			}
-			retval = rtp_ap(ops, next_ap, depth + 1);
-			dap_put_ap(next_ap);
-		} else {
-			/* mode == CS_ACCESS_MEM_AP */
-			retval = rtp_cs_component(mode, ops, ap, component_base, NULL, depth + 1);
-		}
-		if (retval == CORESIGHT_COMPONENT_FOUND)
-			return CORESIGHT_COMPONENT_FOUND;
-		if (retval != ERROR_OK) {
-			/* TODO: do we need to send an ABORT before continuing? */
-			LOG_DEBUG("Ignore error parsing CoreSight component");
-			continue;
 		}
 	}
 
-	return ERROR_OK;
+done:
+	free(batch);
+	return retval;
 }
 
 static int rtp_cs_component(enum coresight_access_mode mode, const struct rtp_ops *ops,
-		struct adiv5_ap *ap, target_addr_t base_address, bool *is_mem_ap, int depth)
+		struct adiv5_ap *ap, target_addr_t base_address, const struct cs_component_vals *prefetched,
+		bool *is_mem_ap, int depth)
 {
 	struct cs_component_vals v;
 	int retval;
@@ -1928,10 +2035,14 @@ static int rtp_cs_component(enum coresight_access_mode mode, const struct rtp_op
 	if (is_mem_ap)
 		*is_mem_ap = false;
 
-	if (depth > ROM_TABLE_MAX_DEPTH)
+	if (depth > ROM_TABLE_MAX_DEPTH) {
 		retval = ERROR_FAIL;
-	else
+	} else if (prefetched) {
+		v = *prefetched;
+		retval = ERROR_OK;
+	} else {
 		retval = rtp_read_cs_regs(mode, ap, base_address, &v);
+	}
 
 	retval = rtp_ops_cs_component(ops, retval, &v, depth);
 	if (retval == CORESIGHT_COMPONENT_FOUND)
@@ -1987,7 +2098,7 @@ static int rtp_ap(const struct rtp_ops *ops, struct adiv5_ap *ap, int depth)
 
 	if (is_adiv6(ap->dap)) {
 		bool is_mem_ap;
-		retval = rtp_cs_component(CS_ACCESS_AP, ops, ap, 0, &is_mem_ap, depth);
+		retval = rtp_cs_component(CS_ACCESS_AP, ops, ap, 0, NULL, &is_mem_ap, depth);
 		if (retval == CORESIGHT_COMPONENT_FOUND)
 			return CORESIGHT_COMPONENT_FOUND;
 		if (retval != ERROR_OK)
@@ -2022,7 +2133,7 @@ static int rtp_ap(const struct rtp_ops *ops, struct adiv5_ap *ap, int depth)
 
 		if (dbgbase != invalid_entry && (dbgbase & 0x3) != 0x2) {
 			retval = rtp_cs_component(CS_ACCESS_MEM_AP, ops, ap,
-					dbgbase & 0xFFFFFFFFFFFFF000ull, NULL, depth);
+					dbgbase & 0xFFFFFFFFFFFFF000ull, NULL, NULL, depth);
 			if (retval == CORESIGHT_COMPONENT_FOUND)
 				return CORESIGHT_COMPONENT_FOUND;
 		}
@@ -2272,9 +2383,129 @@ static int dap_lookup_cs_component_cs_component(int retval,
 	return CORESIGHT_COMPONENT_FOUND;
 }
 
+/*
+ * The ROM table cache file holds one line per component found by
+ * dap_lookup_cs_component(): "dpidr targetid ap_num type core_id base".
+ * DPIDR and TARGETID identify the device, so that one file can serve
+ * several boards.
+ */
+static int dap_romcache_key(struct adiv5_ap *ap, uint8_t type, int32_t core_id,
+		char *key, size_t size)
+{
+	struct adiv5_dap *dap = ap->dap;
+	uint32_t dpidr, targetid = 0;
+
+	int retval = dap_queue_dp_read(dap, DP_DPIDR, &dpidr);
+	if (retval == ERROR_OK)
+		retval = dap_run(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if ((dpidr & DP_DPIDR_VERSION_MASK) >= (2UL << DP_DPIDR_VERSION_SHIFT)) {
+		retval = dap_queue_dp_read(dap, DP_TARGETID, &targetid);
+		if (retval == ERROR_OK)
+			retval = dap_run(dap);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	snprintf(key, size, "0x%08" PRIx32 " 0x%08" PRIx32 " 0x%" PRIx64 " 0x%02x %" PRId32 " ",
+		dpidr, targetid, ap->ap_num, type, core_id);
+
+	return ERROR_OK;
+}
+
+static bool dap_romcache_find(const char *file, const char *key, target_addr_t *base)
+{
+	FILE *f = fopen(file, "r");
+	if (!f)
+		return false;
+
+	char line[128];
+	bool found = false;
+	while (!found && fgets(line, sizeof(line), f)) {
+		if (strncmp(line, key, strlen(key)))
+			continue;
+
+		char *end;
+		*base = strtoull(line + strlen(key), &end, 0);
+		found = end != line + strlen(key);
+	}
+
+	fclose(f);
+	return found;
+}
+
+static void dap_romcache_store(const char *file, const char *key, target_addr_t base)
+{
+	char *text = NULL;
+	size_t len = 0;
+
+	/* keep the entries of other keys */
+	FILE *f = fopen(file, "r");
+	if (f) {
+		char line[128];
+		while (fgets(line, sizeof(line), f)) {
+			if (!strncmp(line, key, strlen(key)))
+				continue;
+			char *t = realloc(text, len + strlen(line) + 1);
+			if (!t)
+				break;
+			text = t;
+			strcpy(text + len, line);
+			len += strlen(line);
+		}
+		fclose(f);
+	}
+
+	f = fopen(file, "w");
+	if (!f) {
+		LOG_WARNING("Can't write ROM table cache file %s", file);
+		free(text);
+		return;
+	}
+	if (text)
+		fputs(text, f);
+	fprintf(f, "%s" TARGET_ADDR_FMT "\n", key, base);
+	fclose(f);
+	free(text);
+}
+
+/* Confirm that a cached component is still there */
+static bool dap_romcache_check(struct adiv5_ap *ap, uint8_t type, target_addr_t base)
+{
+	struct cs_component_vals v;
+	struct dap_lookup_data lookup = {
+		.type = type,
+		.idx  = 0,
+	};
+
+	if (!IS_ALIGNED(base, ARM_CS_ALIGN))
+		return false;
+
+	int retval = rtp_read_cs_regs(CS_ACCESS_MEM_AP, ap, base, &v);
+
+	return dap_lookup_cs_component_cs_component(retval, &v, 0, &lookup)
+		== CORESIGHT_COMPONENT_FOUND;
+}
+
 int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
 		target_addr_t *addr, int32_t core_id)
 {
+	const char *romcache_file = ap->dap->romcache_file;
+	char key[80];
+
+	if (romcache_file && dap_romcache_key(ap, type, core_id, key, sizeof(key)) != ERROR_OK)
+		romcache_file = NULL;
+
+	if (romcache_file && dap_romcache_find(romcache_file, key, addr)) {
+		if (dap_romcache_check(ap, type, *addr)) {
+			LOG_DEBUG("CS lookup found in cache at " TARGET_ADDR_FMT, *addr);
+			return ERROR_OK;
+		}
+		LOG_DEBUG("CS lookup cache entry at " TARGET_ADDR_FMT " is stale", *addr);
+	}
+
 	struct dap_lookup_data lookup = {
 		.type = type,
 		.idx  = core_id,
@@ -2296,6 +2527,8 @@ int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
 		}
 		LOG_DEBUG("CS lookup found at 0x%" PRIx64, lookup.component_base);
 		*addr = lookup.component_base;
+		if (romcache_file)
+			dap_romcache_store(romcache_file, key, *addr);
 		return ERROR_OK;
 	}
 	if (retval != ERROR_OK) {
@@ -2874,6 +3107,30 @@ COMMAND_HANDLER(dap_dpreg_command)
 	return retval;
 }
 
+COMMAND_HANDLER(dap_romcache_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		free(dap->romcache_file);
+		dap->romcache_file = NULL;
+		if (strcmp(CMD_ARGV[0], "off")) {
+			dap->romcache_file = strdup(CMD_ARGV[0]);
+			if (!dap->romcache_file) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	command_print(CMD, "%s", dap->romcache_file ? dap->romcache_file : "off");
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(dap_ti_be_32_quirks_command)
 {
 	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
@@ -2953,6 +3210,14 @@ const struct command_registration dap_instance_commands[] = {
 			"bus access [0-255]",
 		.usage = "[cycles]",
 	},
+	{
+		.name = "romcache",
+		.handler = dap_romcache_command,
+		.mode = COMMAND_ANY,
+		.help = "set/get the file caching the CoreSight components "
+			"found in ROM tables, or 'off'",
+		.usage = "[filename|'off']",
+	},
 	{
 		.name = "ti_be_32_quirks",
 		.handler = dap_ti_be_32_quirks_command,
@@ -23,6 +23,7 @@
 #include <helper/list.h>
 #include "arm_jtag.h"
 #include "helper/bits.h"
+#include "helper/metrics.h"
 
 /* JEP106 ID for ARM */
 #define ARM_ID 0x23B
@@ -434,6 +435,9 @@ struct adiv5_dap {
 
 	/* ADIv6 only field indicating ROM Table address size */
 	unsigned int asize;
+
+	/** File caching the results of dap_lookup_cs_component(), or NULL */
+	char *romcache_file;
 };
 
 /**
@@ -556,6 +560,8 @@ static inline int dap_queue_dp_read(struct adiv5_dap *dap,
 		unsigned reg, uint32_t *data)
 {
 	assert(dap->ops);
+	if (metrics_enabled)
+		metrics_add(METRICS_DAP_TRANSACTIONS, NULL, 1);
 	return dap->ops->queue_dp_read(dap, reg, data);
 }
 
@@ -574,6 +580,8 @@ static inline int dap_queue_dp_write(struct adiv5_dap *dap,
 		unsigned reg, uint32_t data)
 {
 	assert(dap->ops);
+	if (metrics_enabled)
+		metrics_add(METRICS_DAP_TRANSACTIONS, NULL, 1);
 	return dap->ops->queue_dp_write(dap, reg, data);
 }
 
@@ -595,6 +603,8 @@ static inline int dap_queue_ap_read(struct adiv5_ap *ap,
 		ap->refcount = 1;
 		LOG_ERROR("BUG: refcount AP#0x%" PRIx64 " used without get", ap->ap_num);
 	}
+	if (metrics_enabled)
+		metrics_add(METRICS_DAP_TRANSACTIONS, NULL, 1);
 	return ap->dap->ops->queue_ap_read(ap, reg, data);
 }
 
@@ -615,6 +625,8 @@ static inline int dap_queue_ap_write(struct adiv5_ap *ap,
 		ap->refcount = 1;
 		LOG_ERROR("BUG: refcount AP#0x%" PRIx64 " used without get", ap->ap_num);
 	}
+	if (metrics_enabled)
+		metrics_add(METRICS_DAP_TRANSACTIONS, NULL, 1);
 	return ap->dap->ops->queue_ap_write(ap, reg, data);
 }
 
@@ -648,7 +660,12 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 static inline int dap_run(struct adiv5_dap *dap)
 {
 	assert(dap->ops);
-	return dap->ops->run(dap);
+	if (metrics_enabled)
+		metrics_add(METRICS_DAP_RUNS, NULL, 1);
+	int retval = dap->ops->run(dap);
+	log_trace(LOG_TRACE_DAP_RUN, retval, 0);
+	adapter_call_idle_callbacks();
+	return retval;
 }
 
 static inline int dap_sync(struct adiv5_dap *dap)
@@ -171,6 +171,7 @@ int dap_cleanup_all(void)
 		if (dap->ops && dap->ops->quit)
 			dap->ops->quit(dap);
 
+		free(dap->romcache_file);
 		free(obj->name);
 		free(obj);
 	}
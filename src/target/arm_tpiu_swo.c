@@ -30,6 +30,7 @@
 #include <helper/jim-nvp.h>
 #include <helper/list.h>
 #include <helper/log.h>
+#include <helper/metrics.h>
 #include <helper/types.h>
 #include <jtag/interface.h>
 #include <server/server.h>
@@ -45,6 +46,9 @@
 
 #define TCP_SERVICE_NAME                "tpiu_swo_trace"
 
+/* poll trace between adapter queues if the server loop did not for this long */
+#define ARM_TPIU_SWO_IDLE_POLL_MS       10
+
 /* default for Cortex-M3 and Cortex-M4 specific TPIU */
 #define TPIU_SWO_DEFAULT_BASE           0xE0040000
 
@@ -112,6 +116,16 @@ struct arm_tpiu_swo_object {
 	char *out_filename;
 	/** track TCP connections */
 	struct list_head connections;
+	/** time of the last trace poll, in ms */
+	int64_t last_poll;
+	/** ring buffer the adapter's trace data is captured into */
+	uint8_t *ring;
+	/** total bytes captured; the write position is ring_head % ARM_TPIU_SWO_RING_SIZE */
+	uint64_t ring_head;
+	/** bytes of the ring already written to file */
+	uint64_t file_tail;
+	/** time of the last write to file, in ms */
+	int64_t file_last_write;
 	/* START_DEPRECATED_TPIU */
 	bool recheck_ap_cur_target;
 	/* END_DEPRECATED_TPIU */
@@ -120,6 +134,10 @@ struct arm_tpiu_swo_object {
 struct arm_tpiu_swo_connection {
 	struct list_head lh;
 	struct connection *connection;
+	/** bytes of the ring already sent to this client */
+	uint64_t tail;
+	/** client fell behind and is being disconnected */
+	bool dropped;
 };
 
 struct arm_tpiu_swo_priv_connection {
@@ -130,34 +148,144 @@ static LIST_HEAD(all_tpiu_swo);
 
 #define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
 
+/* Captured data is kept in a ring buffer until the file and all the TCP
+ * clients got it. A client that lags more than the ring size is dropped,
+ * so that a slow consumer cannot stall the capture. */
+#define ARM_TPIU_SWO_RING_SIZE		(1024 * 1024)
+
+/* write the captured data to file in chunks of at least this size ... */
+#define ARM_TPIU_SWO_FILE_CHUNK		(64 * 1024)
+/* ... or when the oldest pending data is this old, in ms */
+#define ARM_TPIU_SWO_FILE_LATENCY_MS	100
+
+static int arm_tpiu_swo_write_file(struct arm_tpiu_swo_object *obj, bool force)
+{
+	uint64_t pending = obj->ring_head - obj->file_tail;
+
+	if (!obj->file || !pending)
+		return ERROR_OK;
+
+	if (!force && pending < ARM_TPIU_SWO_FILE_CHUNK
+			&& timeval_ms() - obj->file_last_write < ARM_TPIU_SWO_FILE_LATENCY_MS)
+		return ERROR_OK;
+
+	while (obj->file_tail != obj->ring_head) {
+		size_t pos = obj->file_tail % ARM_TPIU_SWO_RING_SIZE;
+		size_t size = MIN(obj->ring_head - obj->file_tail, ARM_TPIU_SWO_RING_SIZE - pos);
+
+		if (fwrite(obj->ring + pos, 1, size, obj->file) != size) {
+			LOG_ERROR("Error writing to the SWO trace destination file");
+			/* don't retry the same data on every poll */
+			obj->file_tail = obj->ring_head;
+			return ERROR_FAIL;
+		}
+		obj->file_tail += size;
+	}
+
+	fflush(obj->file);
+	obj->file_last_write = timeval_ms();
+
+	return ERROR_OK;
+}
+
+static void arm_tpiu_swo_drop_connection(struct arm_tpiu_swo_connection *c)
+{
+	c->dropped = true;
+	/* the server loop will see the socket closed and release the connection */
+#ifdef _WIN32
+	shutdown(c->connection->fd, SD_BOTH);
+#else
+	shutdown(c->connection->fd, SHUT_RDWR);
+#endif
+}
+
+static void arm_tpiu_swo_write_connections(struct arm_tpiu_swo_object *obj)
+{
+	struct arm_tpiu_swo_connection *c;
+
+	list_for_each_entry(c, &obj->connections, lh) {
+		if (c->dropped)
+			continue;
+
+		if (obj->ring_head - c->tail > ARM_TPIU_SWO_RING_SIZE) {
+			LOG_WARNING("%s: trace client too slow, %" PRIu64 " bytes lost, dropping it",
+				obj->name, obj->ring_head - c->tail - ARM_TPIU_SWO_RING_SIZE);
+			arm_tpiu_swo_drop_connection(c);
+			continue;
+		}
+
+		/* the socket was made non-blocking on accept, send what it
+		 * accepts and keep the rest for the next poll */
+		while (c->tail != obj->ring_head) {
+			size_t pos = c->tail % ARM_TPIU_SWO_RING_SIZE;
+			size_t size = MIN(obj->ring_head - c->tail, ARM_TPIU_SWO_RING_SIZE - pos);
+
+			int written = connection_write(c->connection, obj->ring + pos, size);
+			if (written < 0) {
+#ifdef _WIN32
+				bool retry = (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+				bool retry = (errno == EAGAIN);
+#endif
+				if (!retry) {
+					log_socket_error("SWO trace");
+					arm_tpiu_swo_drop_connection(c);
+				}
+				break;
+			}
+
+			c->tail += written;
+			if ((size_t)written < size)
+				break;
+		}
+	}
+}
+
 static int arm_tpiu_swo_poll_trace(void *priv)
 {
 	struct arm_tpiu_swo_object *obj = priv;
-	uint8_t buf[ARM_TPIU_SWO_TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
-	struct arm_tpiu_swo_connection *c;
+
+	obj->last_poll = timeval_ms();
+
+	if (!obj->ring)
+		return ERROR_OK;
+
+	/* capture straight into the ring, up to its wrap-around point */
+	size_t pos = obj->ring_head % ARM_TPIU_SWO_RING_SIZE;
+	uint8_t *buf = obj->ring + pos;
+	size_t size = MIN(ARM_TPIU_SWO_TRACE_BUF_SIZE, ARM_TPIU_SWO_RING_SIZE - pos);
 
 	int retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
+	if (retval != ERROR_OK)
 		return retval;
 
-	target_call_trace_callbacks(/*target*/NULL, size, buf);
+	if (size) {
+		obj->ring_head += size;
 
-	if (obj->file) {
-		if (fwrite(buf, 1, size, obj->file) == size) {
-			fflush(obj->file);
-		} else {
-			LOG_ERROR("Error writing to the SWO trace destination file");
-			return ERROR_FAIL;
-		}
+		metrics_add(METRICS_SWO_BYTES, NULL, size);
+
+		target_call_trace_callbacks(/*target*/NULL, size, buf);
 	}
 
+	retval = arm_tpiu_swo_write_file(obj, false);
+
 	if (obj->out_filename[0] == ':')
-		list_for_each_entry(c, &obj->connections, lh)
-			if (connection_write(c->connection, buf, size) != (int)size)
-				LOG_ERROR("Error writing to connection"); /* FIXME: which connection? */
+		arm_tpiu_swo_write_connections(obj);
 
-	return ERROR_OK;
+	return retval;
+}
+
+/* Long operations (flash programming, dump_image, ...) keep the server loop
+ * and its timer callbacks from running. Drain the adapter's trace buffer in
+ * between their queue executions so that SWO data is not lost meanwhile. */
+static int arm_tpiu_swo_poll_trace_idle(void *priv)
+{
+	struct arm_tpiu_swo_object *obj = priv;
+
+	if (timeval_ms() - obj->last_poll < ARM_TPIU_SWO_IDLE_POLL_MS)
+		return ERROR_OK;
+
+	return arm_tpiu_swo_poll_trace(priv);
 }
 
 static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_tpiu_swo_event event)
@@ -199,11 +327,14 @@ static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_t
 static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 {
 	if (obj->file) {
+		arm_tpiu_swo_write_file(obj, true);
 		fclose(obj->file);
 		obj->file = NULL;
 	}
 	if (obj->out_filename[0] == ':')
 		remove_service(TCP_SERVICE_NAME, &obj->out_filename[1]);
+	free(obj->ring);
+	obj->ring = NULL;
 }
 
 int arm_tpiu_swo_cleanup_all(void)
@@ -218,6 +349,7 @@ int arm_tpiu_swo_cleanup_all(void)
 
 		if (obj->en_capture) {
 			target_unregister_timer_callback(arm_tpiu_swo_poll_trace, obj);
+			adapter_unregister_idle_callback(arm_tpiu_swo_poll_trace_idle, obj);
 
 			int retval = adapter_config_trace(false, 0, 0, NULL, 0, NULL);
 			if (retval != ERROR_OK)
@@ -256,6 +388,12 @@ static int arm_tpiu_swo_service_new_connection(struct connection *connection)
 		return ERROR_FAIL;
 	}
 	c->connection = connection;
+	/* accepted sockets are blocking, a slow client must not stall the server */
+	if (connection->service->type == CONNECTION_TCP)
+		socket_nonblock(connection->fd);
+	/* a new client only gets the data captured from now on */
+	c->tail = obj->ring_head;
+	c->dropped = false;
 	list_add(&c->lh, &obj->connections);
 	return ERROR_OK;
 }
@@ -741,6 +879,16 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 			}
 		}
 
+		obj->ring = malloc(ARM_TPIU_SWO_RING_SIZE);
+		if (!obj->ring) {
+			LOG_ERROR("Out of memory");
+			arm_tpiu_swo_close_output(obj);
+			return ERROR_FAIL;
+		}
+		obj->ring_head = 0;
+		obj->file_tail = 0;
+		obj->file_last_write = timeval_ms();
+
 		retval = adapter_config_trace(true, obj->pin_protocol, obj->port_width,
 			&swo_pin_freq, obj->traceclkin_freq, &prescaler);
 		if (retval != ERROR_OK) {
@@ -767,6 +915,7 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 
 		target_register_timer_callback(arm_tpiu_swo_poll_trace, 1,
 			TARGET_TIMER_TYPE_PERIODIC, obj);
+		adapter_register_idle_callback(arm_tpiu_swo_poll_trace_idle, obj);
 
 		obj->en_capture = true;
 	} else if (obj->pin_protocol == TPIU_SPPR_PROTOCOL_MANCHESTER || obj->pin_protocol == TPIU_SPPR_PROTOCOL_UART) {
@@ -823,6 +972,7 @@ error_exit:
 		arm_tpiu_swo_close_output(obj);
 
 		target_unregister_timer_callback(arm_tpiu_swo_poll_trace, obj);
+		adapter_unregister_idle_callback(arm_tpiu_swo_poll_trace_idle, obj);
 
 		int retval1 = adapter_config_trace(false, 0, 0, NULL, 0, NULL);
 		if (retval1 != ERROR_OK)
@@ -850,6 +1000,7 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_disable)
 		arm_tpiu_swo_close_output(obj);
 
 		target_unregister_timer_callback(arm_tpiu_swo_poll_trace, obj);
+		adapter_unregister_idle_callback(arm_tpiu_swo_poll_trace_idle, obj);
 
 		int retval = adapter_config_trace(false, 0, 0, NULL, 0, NULL);
 		if (retval != ERROR_OK) {
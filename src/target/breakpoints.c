@@ -36,41 +36,149 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+/* number of buckets of the per target breakpoint address index */
+#define BREAKPOINT_INDEX_SIZE	1024
+
+static unsigned int breakpoint_index_hash(target_addr_t address)
+{
+	/* instructions are at least 2 bytes aligned on most targets */
+	return (address >> 1) % BREAKPOINT_INDEX_SIZE;
+}
+
+/* Append a breakpoint to the target's list. The head's prev points to the
+ * tail of the list, so neither appending nor unlinking has to walk it. */
+static int breakpoint_link(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint *head = target->breakpoints;
+
+	if (!target->breakpoint_index) {
+		target->breakpoint_index = calloc(BREAKPOINT_INDEX_SIZE,
+			sizeof(*target->breakpoint_index));
+		if (!target->breakpoint_index) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	breakpoint->next = NULL;
+	if (head) {
+		breakpoint->prev = head->prev;
+		head->prev->next = breakpoint;
+		head->prev = breakpoint;
+	} else {
+		breakpoint->prev = breakpoint;
+		target->breakpoints = breakpoint;
+	}
+
+	breakpoint->index_next = NULL;
+
+	return ERROR_OK;
+}
+
+/* Add a linked breakpoint to the address index. Done once the target accepted
+ * it, since some targets adjust the address (e.g. MIPS64 sign extension). */
+static void breakpoint_index_add(struct target *target, struct breakpoint *breakpoint)
+{
+	/* keep each bucket in list order, as lookups return the first match */
+	struct breakpoint **index_p =
+		&target->breakpoint_index[breakpoint_index_hash(breakpoint->address)];
+	while (*index_p)
+		index_p = &(*index_p)->index_next;
+	*index_p = breakpoint;
+}
+
+static void breakpoint_unlink(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint *head = target->breakpoints;
+
+	if (breakpoint == head) {
+		target->breakpoints = breakpoint->next;
+		if (breakpoint->next)
+			breakpoint->next->prev = breakpoint->prev;
+	} else {
+		breakpoint->prev->next = breakpoint->next;
+		if (breakpoint->next)
+			breakpoint->next->prev = breakpoint->prev;
+		else
+			head->prev = breakpoint->prev;
+	}
+
+	struct breakpoint **index_p =
+		&target->breakpoint_index[breakpoint_index_hash(breakpoint->address)];
+	while (*index_p) {
+		if (*index_p == breakpoint) {
+			*index_p = breakpoint->index_next;
+			break;
+		}
+		index_p = &(*index_p)->index_next;
+	}
+}
+
+void breakpoint_index_clear(struct target *target)
+{
+	if (target->breakpoint_index)
+		memset(target->breakpoint_index, 0,
+			BREAKPOINT_INDEX_SIZE * sizeof(*target->breakpoint_index));
+}
+
+static struct breakpoint *breakpoint_alloc(target_addr_t address, uint32_t asid,
+	uint32_t length, enum breakpoint_type type)
+{
+	struct breakpoint *breakpoint = malloc(sizeof(struct breakpoint));
+	if (!breakpoint) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+
+	breakpoint->address = address;
+	breakpoint->asid = asid;
+	breakpoint->length = length;
+	breakpoint->type = type;
+	breakpoint->is_set = false;
+	breakpoint->orig_instr = malloc(length);
+	breakpoint->unique_id = bpwp_unique_id++;
+
+	return breakpoint;
+}
+
+static void breakpoint_release(struct target *target, struct breakpoint *breakpoint)
+{
+	breakpoint_unlink(target, breakpoint);
+	free(breakpoint->orig_instr);
+	free(breakpoint);
+}
+
 static int breakpoint_add_internal(struct target *target,
 	target_addr_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 	const char *reason;
 	int retval;
 
-	while (breakpoint) {
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_TARGET_ERROR(target, "Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_TARGET_ERROR(target, "Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = 0;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
+	breakpoint = breakpoint_alloc(address, 0, length, type);
+	if (!breakpoint)
+		return ERROR_FAIL;
+
+	retval = breakpoint_link(target, breakpoint);
+	if (retval != ERROR_OK) {
+		free(breakpoint->orig_instr);
+		free(breakpoint);
+		return retval;
+	}
 
-	retval = target_add_breakpoint(target, *breakpoint_p);
+	retval = target_add_breakpoint(target, breakpoint);
 	switch (retval) {
 		case ERROR_OK:
 			break;
@@ -84,17 +192,17 @@ static int breakpoint_add_internal(struct target *target,
 			reason = "unknown reason";
 fail:
 			LOG_TARGET_ERROR(target, "can't add breakpoint: %s", reason);
-			free((*breakpoint_p)->orig_instr);
-			free(*breakpoint_p);
-			*breakpoint_p = NULL;
+			breakpoint_release(target, breakpoint);
 			return retval;
 	}
 
+	breakpoint_index_add(target, breakpoint);
+
 	LOG_TARGET_DEBUG(target, "added %s breakpoint at " TARGET_ADDR_FMT
 			" of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address, breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -105,9 +213,9 @@ static int context_breakpoint_add_internal(struct target *target,
 	enum breakpoint_type type)
 {
 	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
 	int retval;
 
+	/* not indexed by address, context breakpoints are few */
 	while (breakpoint) {
 		if (breakpoint->asid == asid) {
 			/* FIXME don't assume "same address" means "same
@@ -118,32 +226,33 @@ static int context_breakpoint_add_internal(struct target *target,
 				asid, breakpoint->unique_id);
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 		}
-		breakpoint_p = &breakpoint->next;
 		breakpoint = breakpoint->next;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = 0;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-	retval = target_add_context_breakpoint(target, *breakpoint_p);
+	breakpoint = breakpoint_alloc(0, asid, length, type);
+	if (!breakpoint)
+		return ERROR_FAIL;
+
+	retval = breakpoint_link(target, breakpoint);
+	if (retval != ERROR_OK) {
+		free(breakpoint->orig_instr);
+		free(breakpoint);
+		return retval;
+	}
+
+	retval = target_add_context_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_TARGET_ERROR(target, "could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_release(target, breakpoint);
 		return retval;
 	}
 
+	breakpoint_index_add(target, breakpoint);
+
 	LOG_TARGET_DEBUG(target, "added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->asid, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->asid, breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -154,10 +263,12 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint = NULL;
 	int retval;
 
+	if (target->breakpoint_index)
+		breakpoint = target->breakpoint_index[breakpoint_index_hash(address)];
+
 	while (breakpoint) {
 		if ((breakpoint->asid == asid) && (breakpoint->address == address)) {
 			/* FIXME don't assume "same address" means "same
@@ -173,34 +284,34 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+		breakpoint = breakpoint->index_next;
 	}
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 
+	breakpoint = breakpoint_alloc(address, asid, length, type);
+	if (!breakpoint)
+		return ERROR_FAIL;
+
+	retval = breakpoint_link(target, breakpoint);
+	if (retval != ERROR_OK) {
+		free(breakpoint->orig_instr);
+		free(breakpoint);
+		return retval;
+	}
 
-	retval = target_add_hybrid_breakpoint(target, *breakpoint_p);
+	retval = target_add_hybrid_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_TARGET_ERROR(target, "could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_release(target, breakpoint);
 		return retval;
 	}
+
+	breakpoint_index_add(target, breakpoint);
 	LOG_TARGET_DEBUG(target,
 		"added %s Hybrid breakpoint at address " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address,
-		(*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address,
+		breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -274,22 +385,10 @@ int hybrid_breakpoint_add(struct target *target,
 }
 
 /* free up a breakpoint */
-static int breakpoint_free(struct target *target, struct breakpoint *breakpoint_to_remove)
+static int breakpoint_free(struct target *target, struct breakpoint *breakpoint)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
 	int retval;
 
-	while (breakpoint) {
-		if (breakpoint == breakpoint_to_remove)
-			break;
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
-	}
-
-	if (!breakpoint)
-		return ERROR_OK;
-
 	retval = target_remove_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_TARGET_ERROR(target, "could not remove breakpoint #%d on this target",
@@ -298,22 +397,20 @@ static int breakpoint_free(struct target *target, struct breakpoint *breakpoint_
 	}
 
 	LOG_TARGET_DEBUG(target, "free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
-	(*breakpoint_p) = breakpoint->next;
-	free(breakpoint->orig_instr);
-	free(breakpoint);
+	breakpoint_release(target, breakpoint);
 
 	return ERROR_OK;
 }
 
 static int breakpoint_remove_internal(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 
-	while (breakpoint) {
-		if ((breakpoint->address == address) ||
-		    (breakpoint->address == 0 && breakpoint->asid == address))
-			break;
-		breakpoint = breakpoint->next;
+	if (!breakpoint) {
+		/* context breakpoints are identified by their asid */
+		for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+			if (breakpoint->address == 0 && breakpoint->asid == address)
+				break;
 	}
 
 	if (breakpoint) {
@@ -488,17 +585,119 @@ int breakpoint_clear_target(struct target *target)
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	if (!target->breakpoint_index)
+		return NULL;
+
+	struct breakpoint *breakpoint = target->breakpoint_index[breakpoint_index_hash(address)];
 
 	while (breakpoint) {
 		if (breakpoint->address == address)
 			return breakpoint;
-		breakpoint = breakpoint->next;
+		breakpoint = breakpoint->index_next;
 	}
 
 	return NULL;
 }
 
+/* adjacent software breakpoints share one memory access, as long as the
+ * accessed range stays below this size. The bytes between breakpoints that
+ * are not adjacent are never accessed: they may be anything, even registers. */
+#define BREAKPOINT_BATCH_MAX_SPAN	4096
+
+static int breakpoint_address_compare(const void *a, const void *b)
+{
+	const struct breakpoint *bp_a = *(const struct breakpoint * const *)a;
+	const struct breakpoint *bp_b = *(const struct breakpoint * const *)b;
+
+	if (bp_a->address < bp_b->address)
+		return -1;
+	return bp_a->address > bp_b->address;
+}
+
+int breakpoint_soft_set_pending(struct target *target, target_addr_t address_mask,
+		void (*get_code)(struct target *target, const struct breakpoint *breakpoint,
+			uint8_t *code))
+{
+	struct breakpoint *breakpoint;
+	unsigned int count = 0;
+
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+		if (breakpoint->type == BKPT_SOFT && !breakpoint->is_set)
+			count++;
+
+	if (!count)
+		return ERROR_OK;
+
+	struct breakpoint **pending = malloc(count * sizeof(*pending));
+	uint8_t *buf = malloc(BREAKPOINT_BATCH_MAX_SPAN);
+	if (!pending || !buf) {
+		LOG_ERROR("Out of memory");
+		free(pending);
+		free(buf);
+		return ERROR_FAIL;
+	}
+
+	count = 0;
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+		if (breakpoint->type == BKPT_SOFT && !breakpoint->is_set)
+			pending[count++] = breakpoint;
+
+	qsort(pending, count, sizeof(*pending), breakpoint_address_compare);
+
+	int retval = ERROR_OK;
+	unsigned int first = 0;
+	while (first < count) {
+		target_addr_t start = pending[first]->address & address_mask;
+		target_addr_t end = start + pending[first]->length;
+		unsigned int last = first + 1;
+
+		/* gather the following adjacent breakpoints into the same range */
+		while (last < count) {
+			target_addr_t bp_start = pending[last]->address & address_mask;
+			target_addr_t bp_end = MAX(end, bp_start + pending[last]->length);
+
+			if (bp_start > end
+					|| bp_end - start > BREAKPOINT_BATCH_MAX_SPAN)
+				break;
+			end = bp_end;
+			last++;
+		}
+
+		int status = target_read_buffer(target, start, end - start, buf);
+		if (status == ERROR_OK) {
+			/* save all the original instructions before patching any */
+			for (unsigned int i = first; i < last; i++) {
+				breakpoint = pending[i];
+				memcpy(breakpoint->orig_instr,
+					buf + ((breakpoint->address & address_mask) - start),
+					breakpoint->length);
+			}
+			for (unsigned int i = first; i < last; i++) {
+				breakpoint = pending[i];
+				get_code(target, breakpoint,
+					buf + ((breakpoint->address & address_mask) - start));
+			}
+			status = target_write_buffer(target, start, end - start, buf);
+		}
+
+		if (status == ERROR_OK) {
+			for (unsigned int i = first; i < last; i++)
+				pending[i]->is_set = true;
+			LOG_TARGET_DEBUG(target, "set %u software breakpoints at " TARGET_ADDR_FMT
+				" - " TARGET_ADDR_FMT, last - first, start, end - 1);
+		} else {
+			retval = status;
+		}
+
+		first = last;
+	}
+
+	free(buf);
+	free(pending);
+
+	return retval;
+}
+
 static int watchpoint_add_internal(struct target *target, target_addr_t address,
 		uint32_t length, enum watchpoint_rw rw, uint64_t value, uint64_t mask)
 {
@@ -32,6 +32,10 @@ struct breakpoint {
 	unsigned int number;
 	uint8_t *orig_instr;
 	struct breakpoint *next;
+	/* previous in the target's list; the head points to the tail */
+	struct breakpoint *prev;
+	/* next in the same bucket of the target's address index */
+	struct breakpoint *index_next;
 	uint32_t unique_id;
 	int linked_brp;
 };
@@ -62,6 +66,24 @@ int breakpoint_remove_all(struct target *target);
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address);
 
+/* forget the address index, for targets which free their breakpoint list
+ * by themselves */
+void breakpoint_index_clear(struct target *target);
+
+/**
+ * Write the opcodes of all software breakpoints of @a target which are not
+ * set yet, saving the original instructions. Adjacent breakpoints share a
+ * single read and write of the memory they cover, instead of a round trip
+ * each; the memory between breakpoints is never accessed.
+ * @param address_mask	Mask applied to breakpoint addresses (e.g. Thumb bit).
+ * @param get_code	Fills in the breakpoint instruction for a breakpoint.
+ * @returns ERROR_OK, or the error of a failed access; breakpoints of a
+ * failed range are left unset for the caller to retry one by one.
+ */
+int breakpoint_soft_set_pending(struct target *target, target_addr_t address_mask,
+		void (*get_code)(struct target *target, const struct breakpoint *breakpoint,
+			uint8_t *code));
+
 static inline void breakpoint_hw_set(struct breakpoint *breakpoint, unsigned int hw_number)
 {
 	breakpoint->is_set = true;
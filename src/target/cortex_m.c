@@ -1076,6 +1076,9 @@ static int cortex_m_poll_one(struct target *target)
 
 		target->state = TARGET_RUNNING;
 		LOG_TARGET_WARNING(target, "external resume detected");
+		/* the software breakpoints added while halted were not written yet */
+		if (cortex_m_enable_breakpoints(target) != ERROR_OK)
+			LOG_TARGET_ERROR(target, "failed to set breakpoints on external resume");
 		target_call_event_callbacks(target, TARGET_EVENT_RESUMED);
 		retval = ERROR_OK;
 	}
@@ -1286,16 +1289,42 @@ static int cortex_m_soft_reset_halt(struct target *target)
 	return ERROR_OK;
 }
 
-void cortex_m_enable_breakpoints(struct target *target)
+static void cortex_m_breakpoint_code(struct target *target,
+	const struct breakpoint *breakpoint, uint8_t *code)
+{
+	uint8_t bkpt[4];
+
+	/* NOTE: on ARMv6-M and ARMv7-M, BKPT(0xab) is used for
+	 * semihosting; don't use that.  Otherwise the BKPT
+	 * parameter is arbitrary.
+	 */
+	buf_set_u32(bkpt, 0, 32, ARMV5_T_BKPT(0x11));
+	memcpy(code, bkpt, breakpoint->length);
+}
+
+int cortex_m_enable_breakpoints(struct target *target)
 {
 	struct breakpoint *breakpoint = target->breakpoints;
+	int retval = ERROR_OK;
+
+	/* write the pending software breakpoints in as few accesses as possible,
+	 * whatever fails is retried one by one below */
+	breakpoint_soft_set_pending(target, 0xFFFFFFFE, cortex_m_breakpoint_code);
 
 	/* set any pending breakpoints */
 	while (breakpoint) {
-		if (!breakpoint->is_set)
-			cortex_m_set_breakpoint(target, breakpoint);
+		if (!breakpoint->is_set) {
+			int status = cortex_m_set_breakpoint(target, breakpoint);
+			if (status != ERROR_OK) {
+				LOG_TARGET_ERROR(target, "can't set breakpoint (BPID: %" PRIu32 ") at "
+						TARGET_ADDR_FMT, breakpoint->unique_id, breakpoint->address);
+				retval = status;
+			}
+		}
 		breakpoint = breakpoint->next;
 	}
+
+	return retval;
 }
 
 static int cortex_m_restore_one(struct target *target, bool current,
@@ -1313,7 +1342,9 @@ static int cortex_m_restore_one(struct target *target, bool current,
 
 	if (!debug_execution) {
 		target_free_all_working_areas(target);
-		cortex_m_enable_breakpoints(target);
+		int retval = cortex_m_enable_breakpoints(target);
+		if (retval != ERROR_OK)
+			return retval;
 		cortex_m_enable_watchpoints(target);
 	}
 
@@ -1502,6 +1533,11 @@ static int cortex_m_step(struct target *target, int current,
 
 	uint32_t pc_value = buf_get_u32(pc->value, 0, 32);
 
+	/* interrupt handlers may run during the step, they need the breakpoints */
+	retval = cortex_m_enable_breakpoints(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* the front-end may request us not to handle breakpoints */
 	if (handle_breakpoints) {
 		breakpoint = breakpoint_find(target, pc_value);
@@ -1680,6 +1716,11 @@ static int cortex_m_assert_reset(struct target *target)
 
 	enum reset_types jtag_reset_config = jtag_get_reset_config();
 
+	/* the core may run out of reset, write the software breakpoints
+	 * added while halted as long as the memory is accessible */
+	if (target->state == TARGET_HALTED && cortex_m_enable_breakpoints(target) != ERROR_OK)
+		LOG_TARGET_ERROR(target, "failed to set breakpoints before reset");
+
 	if (target_has_event_action(target, TARGET_EVENT_RESET_ASSERT)) {
 		/* allow scripts to override the reset event */
 
@@ -1910,11 +1951,7 @@ int cortex_m_set_breakpoint(struct target *target, struct breakpoint *breakpoint
 	} else if (breakpoint->type == BKPT_SOFT) {
 		uint8_t code[4];
 
-		/* NOTE: on ARMv6-M and ARMv7-M, BKPT(0xab) is used for
-		 * semihosting; don't use that.  Otherwise the BKPT
-		 * parameter is arbitrary.
-		 */
-		buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
+		cortex_m_breakpoint_code(target, breakpoint, code);
 		retval = target_read_memory(target,
 				breakpoint->address & 0xFFFFFFFE,
 				breakpoint->length, 1,
@@ -1993,6 +2030,12 @@ int cortex_m_add_breakpoint(struct target *target, struct breakpoint *breakpoint
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
+	/* While halted, software breakpoints are only written when the core
+	 * leaves the halted state: resume, step, reset or an external resume
+	 * seen by poll. GDB re-inserts all of them on every resume. */
+	if (breakpoint->type == BKPT_SOFT && target->state == TARGET_HALTED)
+		return ERROR_OK;
+
 	return cortex_m_set_breakpoint(target, breakpoint);
 }
 
@@ -334,7 +334,7 @@ int cortex_m_add_breakpoint(struct target *target, struct breakpoint *breakpoint
 int cortex_m_remove_breakpoint(struct target *target, struct breakpoint *breakpoint);
 int cortex_m_add_watchpoint(struct target *target, struct watchpoint *watchpoint);
 int cortex_m_remove_watchpoint(struct target *target, struct watchpoint *watchpoint);
-void cortex_m_enable_breakpoints(struct target *target);
+int cortex_m_enable_breakpoints(struct target *target);
 void cortex_m_enable_watchpoints(struct target *target);
 void cortex_m_deinit_target(struct target *target);
 int cortex_m_profiling(struct target *target, uint32_t *samples,
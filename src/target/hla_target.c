@@ -305,6 +305,11 @@ static int adapter_poll(struct target *target)
 
 	target->state = state;
 
+	/* resumed externally, write the software breakpoints added while halted */
+	if (prev_target_state == TARGET_HALTED && state == TARGET_RUNNING
+			&& cortex_m_enable_breakpoints(target) != ERROR_OK)
+		LOG_TARGET_ERROR(target, "failed to set breakpoints on external resume");
+
 	if (state == TARGET_HALTED) {
 
 		int retval = adapter_debug_entry(target);
@@ -335,6 +340,11 @@ static int hl_assert_reset(struct target *target)
 
 	LOG_DEBUG("%s", __func__);
 
+	/* the core may run out of reset, write the software breakpoints
+	 * added while halted as long as the memory is accessible */
+	if (target->state == TARGET_HALTED && cortex_m_enable_breakpoints(target) != ERROR_OK)
+		LOG_TARGET_ERROR(target, "failed to set breakpoints before reset");
+
 	enum reset_types jtag_reset_config = jtag_get_reset_config();
 
 	bool srst_asserted = false;
@@ -455,7 +465,9 @@ static int adapter_resume(struct target *target, int current,
 
 	if (!debug_execution) {
 		target_free_all_working_areas(target);
-		cortex_m_enable_breakpoints(target);
+		int retval = cortex_m_enable_breakpoints(target);
+		if (retval != ERROR_OK)
+			return retval;
 		cortex_m_enable_watchpoints(target);
 	}
 
@@ -550,6 +562,11 @@ static int adapter_step(struct target *target, int current,
 
 	uint32_t pc_value = buf_get_u32(pc->value, 0, 32);
 
+	/* write the software breakpoints added while halted */
+	res = cortex_m_enable_breakpoints(target);
+	if (res != ERROR_OK)
+		return res;
+
 	/* the front-end may request us not to handle breakpoints */
 	if (handle_breakpoints) {
 		breakpoint = breakpoint_find(target, pc_value);
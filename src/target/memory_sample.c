@@ -0,0 +1,770 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/list.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <server/server.h>
+
+#include "target.h"
+#include "memory_sample.h"
+
+/* Fixed size records, stored little endian in the ring and in the output:
+ * u64 time in us, u8 bucket, u8 size, u16 reserved, 8 bytes of value */
+#define MEMORY_SAMPLE_MAGIC			"OCDSAMPL"
+#define MEMORY_SAMPLE_VERSION		1
+#define MEMORY_SAMPLE_HEADER_SIZE	16
+#define MEMORY_SAMPLE_RECORD_SIZE	20
+
+#define MEMORY_SAMPLE_BUCKETS			16
+#define MEMORY_SAMPLE_DEFAULT_RECORDS	65536
+#define MEMORY_SAMPLE_DEFAULT_INTERVAL	10
+/* flush the output file at least this often, in ms */
+#define MEMORY_SAMPLE_FILE_LATENCY_MS	100
+
+#define TCP_SERVICE_NAME "memory_sample"
+
+struct memory_sample_bucket {
+	target_addr_t address;
+	/* access size in bytes, 0 if the bucket is unused */
+	unsigned int size;
+};
+
+struct memory_sample {
+	struct target *target;
+	struct memory_sample_bucket buckets[MEMORY_SAMPLE_BUCKETS];
+	/** sampling period, in ms */
+	unsigned int interval;
+	bool running;
+	/** where the records are streamed: file name, ":port" or NULL */
+	char *output;
+	FILE *file;
+	int64_t file_last_flush;
+	/** track TCP connections */
+	struct list_head connections;
+	/** ring of records, ring_records * MEMORY_SAMPLE_RECORD_SIZE bytes */
+	uint8_t *ring;
+	unsigned int ring_records;
+	/** total bytes recorded; the write position is ring_head % ring size */
+	uint64_t ring_head;
+	/** records overwritten in the ring */
+	uint64_t overwritten;
+	uint64_t sample_ticks;
+	/** out of schedule timer calls that were ignored */
+	uint64_t skipped_ticks;
+	int64_t last_tick;
+};
+
+struct memory_sample_connection {
+	struct list_head lh;
+	struct connection *connection;
+	/** bytes of the ring already sent to this client */
+	uint64_t tail;
+	uint8_t header[MEMORY_SAMPLE_HEADER_SIZE];
+	unsigned int header_sent;
+	/** client fell behind and is being disconnected */
+	bool dropped;
+};
+
+struct memory_sample_priv_connection {
+	struct memory_sample *sampler;
+};
+
+static size_t memory_sample_ring_size(const struct memory_sample *sampler)
+{
+	return (size_t)sampler->ring_records * MEMORY_SAMPLE_RECORD_SIZE;
+}
+
+static void memory_sample_header(uint8_t *header)
+{
+	memcpy(header, MEMORY_SAMPLE_MAGIC, 8);
+	h_u32_to_le(header + 8, MEMORY_SAMPLE_VERSION);
+	h_u32_to_le(header + 12, MEMORY_SAMPLE_RECORD_SIZE);
+}
+
+static struct memory_sample *memory_sample_get(struct target *target)
+{
+	struct memory_sample *sampler = target->memory_sample;
+
+	if (sampler)
+		return sampler;
+
+	sampler = calloc(1, sizeof(*sampler));
+	if (!sampler) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+
+	sampler->target = target;
+	sampler->interval = MEMORY_SAMPLE_DEFAULT_INTERVAL;
+	sampler->ring_records = MEMORY_SAMPLE_DEFAULT_RECORDS;
+	INIT_LIST_HEAD(&sampler->connections);
+	target->memory_sample = sampler;
+
+	return sampler;
+}
+
+static void memory_sample_drop_connection(struct memory_sample_connection *c)
+{
+	c->dropped = true;
+	/* the server loop will see the socket closed and release the connection */
+#ifdef _WIN32
+	shutdown(c->connection->fd, SD_BOTH);
+#else
+	shutdown(c->connection->fd, SHUT_RDWR);
+#endif
+}
+
+/* Send what the non-blocking socket accepts, drop the client on errors.
+ * Returns the number of bytes sent. */
+static size_t memory_sample_send(struct memory_sample_connection *c,
+		const uint8_t *data, size_t size)
+{
+	int written = connection_write(c->connection, data, size);
+	if (written < 0) {
+#ifdef _WIN32
+		bool retry = (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+		bool retry = (errno == EAGAIN);
+#endif
+		if (!retry) {
+			log_socket_error("memory sample");
+			memory_sample_drop_connection(c);
+		}
+		return 0;
+	}
+
+	return written;
+}
+
+static void memory_sample_write_connections(struct memory_sample *sampler)
+{
+	size_t ring_size = memory_sample_ring_size(sampler);
+	struct memory_sample_connection *c;
+
+	list_for_each_entry(c, &sampler->connections, lh) {
+		if (c->dropped)
+			continue;
+
+		if (sampler->ring_head - c->tail > ring_size) {
+			LOG_TARGET_WARNING(sampler->target, "memory sample client too slow, dropping it");
+			memory_sample_drop_connection(c);
+			continue;
+		}
+
+		/* the header first, it may not have fit when the client connected */
+		if (c->header_sent < MEMORY_SAMPLE_HEADER_SIZE) {
+			c->header_sent += memory_sample_send(c, c->header + c->header_sent,
+				MEMORY_SAMPLE_HEADER_SIZE - c->header_sent);
+			if (c->header_sent < MEMORY_SAMPLE_HEADER_SIZE)
+				continue;
+		}
+
+		/* keep what the socket does not accept for the next tick */
+		while (c->tail != sampler->ring_head && !c->dropped) {
+			size_t pos = c->tail % ring_size;
+			size_t size = MIN(sampler->ring_head - c->tail, ring_size - pos);
+			size_t written = memory_sample_send(c, sampler->ring + pos, size);
+
+			c->tail += written;
+			if (written < size)
+				break;
+		}
+	}
+}
+
+static void memory_sample_record(struct memory_sample *sampler, uint64_t time_us,
+		unsigned int bucket, unsigned int size, uint64_t value)
+{
+	size_t ring_size = memory_sample_ring_size(sampler);
+	uint8_t *r = sampler->ring + sampler->ring_head % ring_size;
+
+	h_u64_to_le(r, time_us);
+	r[8] = bucket;
+	r[9] = size;
+	h_u16_to_le(r + 10, 0);
+	h_u64_to_le(r + 12, value);
+
+	if (sampler->ring_head >= ring_size)
+		sampler->overwritten++;
+	sampler->ring_head += MEMORY_SAMPLE_RECORD_SIZE;
+
+	if (sampler->file && fwrite(r, 1, MEMORY_SAMPLE_RECORD_SIZE, sampler->file)
+			!= MEMORY_SAMPLE_RECORD_SIZE) {
+		LOG_TARGET_ERROR(sampler->target, "error writing memory samples to \"%s\"",
+			sampler->output);
+		fclose(sampler->file);
+		sampler->file = NULL;
+	}
+}
+
+static void memory_sample_close_output(struct memory_sample *sampler)
+{
+	if (sampler->file) {
+		fclose(sampler->file);
+		sampler->file = NULL;
+	}
+	if (sampler->output && sampler->output[0] == ':')
+		remove_service(TCP_SERVICE_NAME, &sampler->output[1]);
+}
+
+static int memory_sample_tick(void *priv);
+
+static void memory_sample_stop(struct memory_sample *sampler)
+{
+	if (!sampler->running)
+		return;
+
+	target_unregister_timer_callback(memory_sample_tick, sampler);
+	memory_sample_close_output(sampler);
+	sampler->running = false;
+}
+
+static int memory_sample_tick(void *priv)
+{
+	struct memory_sample *sampler = priv;
+	struct target *target = sampler->target;
+	int64_t now = timeval_ms();
+
+	/* periodic timers are also run out of schedule, e.g. by
+	 * target_call_timer_callbacks_now(); keep the sampling period */
+	if (sampler->last_tick && now - sampler->last_tick < sampler->interval / 2) {
+		sampler->skipped_ticks++;
+		return ERROR_OK;
+	}
+	sampler->last_tick = now;
+
+	if (!target_was_examined(target) || target->state != TARGET_RUNNING)
+		return ERROR_OK;
+
+	sampler->sample_ticks++;
+
+	for (unsigned int i = 0; i < MEMORY_SAMPLE_BUCKETS; i++) {
+		const struct memory_sample_bucket *bucket = &sampler->buckets[i];
+		uint8_t buf[8];
+		struct timeval tv;
+		uint64_t value;
+
+		if (!bucket->size)
+			continue;
+
+		int retval = target_read_memory(target, bucket->address, bucket->size, 1, buf);
+		if (retval != ERROR_OK) {
+			LOG_TARGET_ERROR(target, "failed to sample memory at " TARGET_ADDR_FMT
+				", stopping the memory sampler", bucket->address);
+			if (retval == ERROR_TARGET_NOT_HALTED)
+				LOG_TARGET_INFO(target, "this target can't access memory while running, "
+					"sample through a mem_ap target on the system bus instead");
+			memory_sample_stop(sampler);
+			return retval;
+		}
+
+		gettimeofday(&tv, NULL);
+
+		switch (bucket->size) {
+		case 1:
+			value = buf[0];
+			break;
+		case 2:
+			value = target_buffer_get_u16(target, buf);
+			break;
+		case 4:
+			value = target_buffer_get_u32(target, buf);
+			break;
+		default:
+			value = target_buffer_get_u64(target, buf);
+			break;
+		}
+
+		memory_sample_record(sampler, (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec,
+			i, bucket->size, value);
+	}
+
+	if (sampler->file && now - sampler->file_last_flush >= MEMORY_SAMPLE_FILE_LATENCY_MS) {
+		fflush(sampler->file);
+		sampler->file_last_flush = now;
+	}
+
+	if (sampler->output && sampler->output[0] == ':')
+		memory_sample_write_connections(sampler);
+
+	return ERROR_OK;
+}
+
+static int memory_sample_service_new_connection(struct connection *connection)
+{
+	struct memory_sample_priv_connection *priv = connection->service->priv;
+	struct memory_sample *sampler = priv->sampler;
+
+	struct memory_sample_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* accepted sockets are blocking, a slow client must not stall the server */
+	if (connection->service->type == CONNECTION_TCP)
+		socket_nonblock(connection->fd);
+
+	c->connection = connection;
+	/* a new client only gets the samples taken from now on */
+	c->tail = sampler->ring_head;
+	c->dropped = false;
+	memory_sample_header(c->header);
+	c->header_sent = memory_sample_send(c, c->header, sizeof(c->header));
+	list_add(&c->lh, &sampler->connections);
+	return ERROR_OK;
+}
+
+static int memory_sample_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int memory_sample_service_connection_closed(struct connection *connection)
+{
+	struct memory_sample_priv_connection *priv = connection->service->priv;
+	struct memory_sample *sampler = priv->sampler;
+	struct memory_sample_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &sampler->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver memory_sample_service_driver = {
+	.name = "memory_sample",
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = memory_sample_service_new_connection,
+	.input_handler = memory_sample_service_input,
+	.connection_closed_handler = memory_sample_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static int memory_sample_open_output(struct memory_sample *sampler)
+{
+	if (!sampler->output)
+		return ERROR_OK;
+
+	if (sampler->output[0] == ':') {
+		struct memory_sample_priv_connection *priv = malloc(sizeof(*priv));
+		if (!priv) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		priv->sampler = sampler;
+		LOG_TARGET_INFO(sampler->target, "starting memory sample server on %s",
+			&sampler->output[1]);
+		return add_service(&memory_sample_service_driver, &sampler->output[1],
+			CONNECTION_LIMIT_UNLIMITED, priv);
+	}
+
+	uint8_t header[MEMORY_SAMPLE_HEADER_SIZE];
+
+	sampler->file = fopen(sampler->output, "wb");
+	if (!sampler->file) {
+		LOG_ERROR("can't open memory sample file \"%s\"", sampler->output);
+		return ERROR_FAIL;
+	}
+
+	memory_sample_header(header);
+	if (fwrite(header, 1, sizeof(header), sampler->file) != sizeof(header)) {
+		LOG_ERROR("error writing memory sample file \"%s\"", sampler->output);
+		fclose(sampler->file);
+		sampler->file = NULL;
+		return ERROR_FAIL;
+	}
+	sampler->file_last_flush = timeval_ms();
+
+	return ERROR_OK;
+}
+
+static int memory_sample_dump(struct memory_sample *sampler, const char *file_name)
+{
+	uint8_t header[MEMORY_SAMPLE_HEADER_SIZE];
+	size_t ring_size = memory_sample_ring_size(sampler);
+	int retval = ERROR_OK;
+
+	if (!sampler->ring) {
+		LOG_ERROR("no memory samples recorded");
+		return ERROR_FAIL;
+	}
+
+	FILE *file = fopen(file_name, "wb");
+	if (!file) {
+		LOG_ERROR("failed to open memory sample dump \"%s\"", file_name);
+		return ERROR_FAIL;
+	}
+
+	uint64_t first = 0;
+	if (sampler->ring_head > ring_size)
+		first = sampler->ring_head - ring_size;
+
+	memory_sample_header(header);
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+		retval = ERROR_FAIL;
+
+	/* oldest first */
+	while (first != sampler->ring_head && retval == ERROR_OK) {
+		size_t pos = first % ring_size;
+		size_t size = MIN(sampler->ring_head - first, ring_size - pos);
+
+		if (fwrite(sampler->ring + pos, 1, size, file) != size)
+			retval = ERROR_FAIL;
+		first += size;
+	}
+
+	if (fclose(file) != 0)
+		retval = ERROR_FAIL;
+
+	if (retval != ERROR_OK)
+		LOG_ERROR("failed to write memory sample dump \"%s\"", file_name);
+
+	return retval;
+}
+
+void memory_sample_free(struct target *target)
+{
+	struct memory_sample *sampler = target->memory_sample;
+
+	if (!sampler)
+		return;
+
+	memory_sample_stop(sampler);
+	free(sampler->output);
+	free(sampler->ring);
+	free(sampler);
+	target->memory_sample = NULL;
+}
+
+COMMAND_HANDLER(handle_memory_sample_bucket_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sample *sampler = memory_sample_get(target);
+	unsigned int idx;
+
+	if (!sampler)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC == 0) {
+		for (unsigned int i = 0; i < MEMORY_SAMPLE_BUCKETS; i++) {
+			const struct memory_sample_bucket *bucket = &sampler->buckets[i];
+			if (bucket->size)
+				command_print(CMD, "%2u: " TARGET_ADDR_FMT " %u", i,
+					bucket->address, bucket->size);
+		}
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 2 && CMD_ARGC != 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], idx);
+	if (idx >= MEMORY_SAMPLE_BUCKETS) {
+		command_print(CMD, "bucket must be less than %d", MEMORY_SAMPLE_BUCKETS);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct memory_sample_bucket *bucket = &sampler->buckets[idx];
+
+	if (CMD_ARGC == 2) {
+		if (strcmp(CMD_ARGV[1], "clear") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		bucket->size = 0;
+		return ERROR_OK;
+	}
+
+	target_addr_t address;
+	unsigned int size;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], size);
+	if (size != 1 && size != 2 && size != 4 && size != 8) {
+		command_print(CMD, "size must be 1, 2, 4 or 8 bytes");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	bucket->address = address;
+	bucket->size = size;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_interval_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sample *sampler = memory_sample_get(target);
+
+	if (!sampler)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int interval;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], interval);
+		if (!interval) {
+			command_print(CMD, "interval must be at least 1 ms");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		if (sampler->running) {
+			command_print(CMD, "can't change the interval while sampling");
+			return ERROR_FAIL;
+		}
+
+		sampler->interval = interval;
+	}
+
+	command_print(CMD, "%u ms", sampler->interval);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_buffer_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sample *sampler = memory_sample_get(target);
+
+	if (!sampler)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int records;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], records);
+		if (!records) {
+			command_print(CMD, "the buffer must hold at least one record");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		if (sampler->running) {
+			command_print(CMD, "can't resize the buffer while sampling");
+			return ERROR_FAIL;
+		}
+
+		if (records != sampler->ring_records) {
+			free(sampler->ring);
+			sampler->ring = NULL;
+			sampler->ring_records = records;
+		}
+	}
+
+	command_print(CMD, "%u records", sampler->ring_records);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_output_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sample *sampler = memory_sample_get(target);
+
+	if (!sampler)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (sampler->running) {
+			command_print(CMD, "can't change the output while sampling");
+			return ERROR_FAIL;
+		}
+
+		free(sampler->output);
+		sampler->output = NULL;
+		if (strcmp(CMD_ARGV[0], "none") != 0) {
+			sampler->output = strdup(CMD_ARGV[0]);
+			if (!sampler->output) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	command_print(CMD, "%s", sampler->output ? sampler->output : "none");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_start_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sample *sampler = memory_sample_get(target);
+
+	if (!sampler)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (sampler->running)
+		return ERROR_OK;
+
+	if (!sampler->ring) {
+		sampler->ring = malloc(memory_sample_ring_size(sampler));
+		if (!sampler->ring) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+	sampler->ring_head = 0;
+	sampler->overwritten = 0;
+	sampler->sample_ticks = 0;
+	sampler->skipped_ticks = 0;
+	sampler->last_tick = 0;
+
+	int retval = memory_sample_open_output(sampler);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_register_timer_callback(memory_sample_tick, sampler->interval,
+		TARGET_TIMER_TYPE_PERIODIC, sampler);
+	if (retval != ERROR_OK) {
+		memory_sample_close_output(sampler);
+		return retval;
+	}
+
+	sampler->running = true;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_stop_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (target->memory_sample)
+		memory_sample_stop(target->memory_sample);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_dump_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target->memory_sample) {
+		command_print(CMD, "no memory samples recorded");
+		return ERROR_FAIL;
+	}
+
+	return memory_sample_dump(target->memory_sample, CMD_ARGV[0]);
+}
+
+COMMAND_HANDLER(handle_memory_sample_status_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sample *sampler = target->memory_sample;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!sampler) {
+		command_print(CMD, "memory sampler is not configured");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "memory sampler is %s, every %u ms, output %s",
+		sampler->running ? "running" : "stopped", sampler->interval,
+		sampler->output ? sampler->output : "none");
+	command_print(CMD, "%" PRIu64 " records in a ring of %u, %" PRIu64 " overwritten",
+		MIN(sampler->ring_head / MEMORY_SAMPLE_RECORD_SIZE, (uint64_t)sampler->ring_records),
+		sampler->ring_records, sampler->overwritten);
+	command_print(CMD, "%" PRIu64 " sampling ticks, %" PRIu64 " out of schedule calls skipped",
+		sampler->sample_ticks, sampler->skipped_ticks);
+	return ERROR_OK;
+}
+
+static const struct command_registration memory_sample_subcommand_handlers[] = {
+	{
+		.name = "bucket",
+		.handler = handle_memory_sample_bucket_command,
+		.mode = COMMAND_ANY,
+		.help = "set, clear or list the memory locations to sample",
+		.usage = "[bucket (address size | 'clear')]",
+	},
+	{
+		.name = "interval",
+		.handler = handle_memory_sample_interval_command,
+		.mode = COMMAND_ANY,
+		.help = "set or display the sampling period in ms",
+		.usage = "[ms]",
+	},
+	{
+		.name = "buffer",
+		.handler = handle_memory_sample_buffer_command,
+		.mode = COMMAND_ANY,
+		.help = "set or display the number of records kept in the ring buffer",
+		.usage = "[num_records]",
+	},
+	{
+		.name = "output",
+		.handler = handle_memory_sample_output_command,
+		.mode = COMMAND_ANY,
+		.help = "stream the samples to a file or to TCP clients on a port",
+		.usage = "[file_name | ':port' | 'none']",
+	},
+	{
+		.name = "start",
+		.handler = handle_memory_sample_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "start sampling while the target runs",
+		.usage = "",
+	},
+	{
+		.name = "stop",
+		.handler = handle_memory_sample_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop sampling and close the output",
+		.usage = "",
+	},
+	{
+		.name = "dump",
+		.handler = handle_memory_sample_dump_command,
+		.mode = COMMAND_EXEC,
+		.help = "write the records kept in the ring buffer to a binary file",
+		.usage = "file_name",
+	},
+	{
+		.name = "status",
+		.handler = handle_memory_sample_status_command,
+		.mode = COMMAND_EXEC,
+		.help = "display the state of the memory sampler",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration memory_sample_command_handlers[] = {
+	{
+		.name = "memory_sample",
+		.mode = COMMAND_ANY,
+		.help = "periodic sampling of memory locations while the target runs",
+		.usage = "",
+		.chain = memory_sample_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
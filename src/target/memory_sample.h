@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_MEMORY_SAMPLE_H
+#define OPENOCD_TARGET_MEMORY_SAMPLE_H
+
+#include <helper/command.h>
+
+struct target;
+
+/** @file
+ * Target independent memory sampler. While the target runs, a set of
+ * memory locations is periodically read through target_read_memory() and
+ * the values are recorded with a timestamp in a ring buffer, which can be
+ * streamed to a file or to TCP clients and dumped on request.
+ */
+
+extern const struct command_registration memory_sample_command_handlers[];
+
+/** Stop sampling on @a target and release the sampler. */
+void memory_sample_free(struct target *target);
+
+#endif /* OPENOCD_TARGET_MEMORY_SAMPLE_H */
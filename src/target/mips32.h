@@ -68,6 +68,8 @@
 #define MIPS32_ARCH_REL2 0x1
 
 #define MIPS32_SCAN_DELAY_LEGACY_MODE 2000000
+/* smallest scan delay used after the fast queued mode lost the handshake */
+#define MIPS32_SCAN_DELAY_MIN 1000
 
 #define MIPS32NUMDSPREGS		9
 
@@ -91,17 +91,38 @@ static int wait_for_pracc_rw(struct mips_ejtag *ejtag_info)
 	return ERROR_OK;
 }
 
-/* Shift in control and address for a new processor access, save them in ejtag_info */
+/* Shift in control and address for a new processor access, save them in ejtag_info.
+ * Both registers are scanned in the same queue flush, together with the data and
+ * finish scans of the previous access: the address is simply discarded and the
+ * pair is scanned again while the PrAcc bit is not set. */
 static int mips32_pracc_read_ctrl_addr(struct mips_ejtag *ejtag_info)
 {
-	int retval = wait_for_pracc_rw(ejtag_info);
-	if (retval != ERROR_OK)
-		return retval;
+	int64_t then = timeval_ms();
+	uint8_t ctrl_in[4];
+	uint8_t addr_in[4];
+
+	while (1) {
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+		mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl, ctrl_in);
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+		mips_ejtag_drscan_32_queued(ejtag_info, 0, addr_in);
+
+		int retval = jtag_execute_queue();
+		if (retval != ERROR_OK)
+			return retval;
 
-	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+		ejtag_info->pa_ctrl = buf_get_u32(ctrl_in, 0, 32);
+		if (ejtag_info->pa_ctrl & EJTAG_CTRL_PRACC)
+			break;
+
+		if (timeval_ms() - then > 1000) {
+			LOG_DEBUG("DEBUGMODULE: No memory access in progress!");
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+	}
 
-	ejtag_info->pa_addr = 0;
-	return  mips_ejtag_drscan_32(ejtag_info, &ejtag_info->pa_addr);
+	ejtag_info->pa_addr = buf_get_u32(addr_in, 0, 32);
+	return ERROR_OK;
 }
 
 /* Finish processor access */
@@ -341,21 +362,13 @@ inline void pracc_queue_free(struct pracc_queue_info *ctx)
 	free(ctx->pracc_list);
 }
 
-int mips32_pracc_queue_exec(struct mips_ejtag *ejtag_info, struct pracc_queue_info *ctx,
-					uint32_t *buf, bool check_last)
+/* Fast queued mode: shift the whole queue out in one flush, assuming every
+ * processor access is pending after scan_delay, and verify the captured
+ * control and address registers afterwards. Returns ERROR_JTAG_DEVICE_ERROR
+ * when the processor did not keep up. */
+static int mips32_pracc_exec_fast(struct mips_ejtag *ejtag_info, struct pracc_queue_info *ctx,
+					uint32_t *buf)
 {
-	if (ctx->retval != ERROR_OK) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
-
-	if (ejtag_info->isa && ejtag_info->endianness)
-		for (int i = 0; i != ctx->code_count; i++)
-			ctx->pracc_list[i].instr = SWAP16(ctx->pracc_list[i].instr);
-
-	if (ejtag_info->mode == 0)
-		return mips32_pracc_exec(ejtag_info, ctx, buf, check_last);
-
 	union scan_in {
 		uint8_t scan_96[12];
 		struct {
@@ -400,19 +413,19 @@ int mips32_pracc_queue_exec(struct mips_ejtag *ejtag_info, struct pracc_queue_in
 		ejtag_ctrl = buf_get_u32(scan_in[scan_count].scan_32.ctrl, 0, 32);
 		uint32_t addr = buf_get_u32(scan_in[scan_count].scan_32.addr, 0, 32);
 		if (!(ejtag_ctrl & EJTAG_CTRL_PRACC)) {
-			LOG_ERROR("Error: access not pending  count: %d", scan_count);
-			retval = ERROR_FAIL;
+			LOG_DEBUG("access not pending, count: %d", scan_count);
+			retval = ERROR_JTAG_DEVICE_ERROR;
 			goto exit;
 		}
 		if (ejtag_ctrl & EJTAG_CTRL_PRNW) {
-			LOG_ERROR("Not a fetch/read access, count: %d", scan_count);
-			retval = ERROR_FAIL;
+			LOG_DEBUG("not a fetch/read access, count: %d", scan_count);
+			retval = ERROR_JTAG_DEVICE_ERROR;
 			goto exit;
 		}
 		if (addr != fetch_addr) {
-			LOG_ERROR("Fetch addr mismatch, read: %" PRIx32 " expected: %" PRIx32 " count: %d",
+			LOG_DEBUG("fetch addr mismatch, read: %" PRIx32 " expected: %" PRIx32 " count: %d",
 					  addr, fetch_addr, scan_count);
-			retval = ERROR_FAIL;
+			retval = ERROR_JTAG_DEVICE_ERROR;
 			goto exit;
 		}
 		fetch_addr += 4;
@@ -425,14 +438,14 @@ int mips32_pracc_queue_exec(struct mips_ejtag *ejtag_info, struct pracc_queue_in
 			addr = buf_get_u32(scan_in[scan_count].scan_32.addr, 0, 32);
 
 			if (!(ejtag_ctrl & EJTAG_CTRL_PRNW)) {
-				LOG_ERROR("Not a store/write access, count: %d", scan_count);
-				retval = ERROR_FAIL;
+				LOG_DEBUG("not a store/write access, count: %d", scan_count);
+				retval = ERROR_JTAG_DEVICE_ERROR;
 				goto exit;
 			}
 			if (addr != store_addr) {
-				LOG_ERROR("Store address mismatch, read: %" PRIx32 " expected: %" PRIx32 " count: %d",
+				LOG_DEBUG("store address mismatch, read: %" PRIx32 " expected: %" PRIx32 " count: %d",
 							      addr, store_addr, scan_count);
-				retval = ERROR_FAIL;
+				retval = ERROR_JTAG_DEVICE_ERROR;
 				goto exit;
 			}
 			int buf_index = (addr - MIPS32_PRACC_PARAM_OUT) / 4;
@@ -445,6 +458,53 @@ exit:
 	return retval;
 }
 
+/* The processor did not keep up with the fast queued mode: double the scan
+ * delay, down to the legacy handshake once it reaches the legacy threshold */
+static void mips32_pracc_slow_down(struct mips_ejtag *ejtag_info)
+{
+	ejtag_info->scan_delay = MAX(2 * ejtag_info->scan_delay, MIPS32_SCAN_DELAY_MIN);
+
+	if (ejtag_info->scan_delay >= MIPS32_SCAN_DELAY_LEGACY_MODE) {
+		ejtag_info->mode = 0;
+		LOG_WARNING("MIPS32: processor access handshake lost, switching to legacy mode");
+	} else {
+		LOG_INFO("MIPS32: processor access handshake lost, scan delay raised to %u nsec",
+			ejtag_info->scan_delay);
+	}
+}
+
+int mips32_pracc_queue_exec(struct mips_ejtag *ejtag_info, struct pracc_queue_info *ctx,
+					uint32_t *buf, bool check_last)
+{
+	if (ctx->retval != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (ejtag_info->isa && ejtag_info->endianness)
+		for (int i = 0; i != ctx->code_count; i++)
+			ctx->pracc_list[i].instr = SWAP16(ctx->pracc_list[i].instr);
+
+	if (ejtag_info->mode == 0)
+		return mips32_pracc_exec(ejtag_info, ctx, buf, check_last);
+
+	int retval = mips32_pracc_exec_fast(ejtag_info, ctx, buf);
+
+	/* Code that leaves debug mode is not checked to its end. Otherwise
+	 * slow down and resync the processor to the pracc text for the next
+	 * queue. This one is not run again: the failed pass may already have
+	 * executed misfed instructions and stores, so report the error. */
+	if (retval != ERROR_JTAG_DEVICE_ERROR || !check_last)
+		return retval;
+
+	mips32_pracc_slow_down(ejtag_info);
+
+	if (mips32_pracc_clean_text_jump(ejtag_info) != ERROR_OK)
+		LOG_ERROR("MIPS32: failed to resync the processor access");
+
+	return retval;
+}
+
 static int mips32_pracc_read_u32(struct mips_ejtag *ejtag_info, uint32_t addr, uint32_t *buf)
 {
 	struct pracc_queue_info ctx = {.ejtag_info = ejtag_info};
@@ -47,6 +47,7 @@ static int riscv013_on_halt(struct target *target);
 static int riscv013_on_step(struct target *target);
 static int riscv013_resume_prep(struct target *target);
 static bool riscv013_is_halted(struct target *target);
+static int riscv013_get_hart_states(struct target *target);
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target);
 static int riscv013_write_debug_buffer(struct target *target, unsigned index,
 		riscv_insn_t d);
@@ -191,6 +192,21 @@ typedef struct {
 	 * go low. */
 	unsigned int ac_busy_delay;
 
+	/* Delay increases so far, to tell whether a batch met any busy response. */
+	unsigned int busy_events;
+	/* Consecutive batches without busy responses. */
+	unsigned int clean_batches;
+	/* Clean batches after which the delays above are lowered again. Doubled
+	 * whenever a lowered delay turns out to be too short. */
+	unsigned int decay_batches;
+	/* The last change to the delays lowered them. */
+	bool delays_lowered;
+	/* Number of scans in each memory transfer batch. */
+	unsigned int batch_scans;
+
+	/* Throughput of the last memory read and write of at least 1 KiB. */
+	unsigned int read_kib_per_s, write_kib_per_s;
+
 	bool abstract_read_csr_supported;
 	bool abstract_write_csr_supported;
 	bool abstract_read_fpr_supported;
@@ -447,10 +463,71 @@ static uint32_t dtmcontrol_scan(struct target *target, uint32_t out)
 	return in;
 }
 
+#define RISCV013_BATCH_MIN_SCANS	32
+#define RISCV013_BATCH_MAX_SCANS	1024
+#define RISCV013_DECAY_MIN_BATCHES	16
+#define RISCV013_DECAY_MAX_BATCHES	4096
+
+/* Called whenever one of the delays goes up because of a busy response. */
+static void busy_delay_increased(riscv013_info_t *info)
+{
+	info->busy_events++;
+	info->clean_batches = 0;
+	info->batch_scans = MAX(info->batch_scans / 2, RISCV013_BATCH_MIN_SCANS);
+	if (info->delays_lowered)
+		info->decay_batches = MIN(info->decay_batches * 2,
+				RISCV013_DECAY_MAX_BATCHES);
+	info->delays_lowered = false;
+}
+
+static bool lower_delay(unsigned int *delay)
+{
+	if (!*delay)
+		return false;
+	*delay -= MIN(*delay, *delay / 8 + 1);
+	return true;
+}
+
+/* Account for a finished memory transfer batch. busy_events is the value of
+ * info->busy_events before the batch was started. Batches grow while no busy
+ * responses come back, and after decay_batches clean ones in a row the delays
+ * are lowered again, so a transient busy doesn't slow down the rest of the
+ * session. */
+static void batch_tune(struct target *target, unsigned int busy_events)
+{
+	RISCV013_INFO(info);
+
+	if (info->busy_events != busy_events)
+		return;
+
+	info->batch_scans = MIN(info->batch_scans * 2, RISCV013_BATCH_MAX_SCANS);
+
+	if (++info->clean_batches < info->decay_batches)
+		return;
+	info->clean_batches = 0;
+
+	bool lowered = lower_delay(&info->dmi_busy_delay);
+	lowered |= lower_delay(&info->ac_busy_delay);
+	lowered |= lower_delay(&info->bus_master_read_delay);
+	lowered |= lower_delay(&info->bus_master_write_delay);
+	info->delays_lowered = lowered;
+	if (lowered)
+		LOG_DEBUG("dmi_busy_delay=%d, ac_busy_delay=%d, bus_master_read_delay=%d, "
+				"bus_master_write_delay=%d", info->dmi_busy_delay, info->ac_busy_delay,
+				info->bus_master_read_delay, info->bus_master_write_delay);
+}
+
+static void increase_bus_master_delay(riscv013_info_t *info, unsigned int *delay)
+{
+	*delay += *delay / 10 + 1;
+	busy_delay_increased(info);
+}
+
 static void increase_dmi_busy_delay(struct target *target)
 {
 	riscv013_info_t *info = get_info(target);
 	info->dmi_busy_delay += info->dmi_busy_delay / 10 + 1;
+	busy_delay_increased(info);
 	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
 			info->dtmcs_idle, info->dmi_busy_delay,
 			info->ac_busy_delay);
@@ -712,6 +789,7 @@ static void increase_ac_busy_delay(struct target *target)
 {
 	riscv013_info_t *info = get_info(target);
 	info->ac_busy_delay += info->ac_busy_delay / 10 + 1;
+	busy_delay_increased(info);
 	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
 			info->dtmcs_idle, info->dmi_busy_delay,
 			info->ac_busy_delay);
@@ -1900,6 +1978,12 @@ static COMMAND_HELPER(riscv013_print_info, struct target *target)
 	if (dmstatus_read(target, &dmstatus, false) == ERROR_OK)
 		riscv_print_info_line(CMD, "dm", "authenticated", get_field(dmstatus, DM_DMSTATUS_AUTHENTICATED));
 
+	riscv_print_info_line(CMD, "dm", "dmi_busy_delay", info->dmi_busy_delay);
+	riscv_print_info_line(CMD, "dm", "ac_busy_delay", info->ac_busy_delay);
+	riscv_print_info_line(CMD, "dm", "batch_scans", info->batch_scans);
+	riscv_print_info_line(CMD, "dm", "read_kib_per_s", info->read_kib_per_s);
+	riscv_print_info_line(CMD, "dm", "write_kib_per_s", info->write_kib_per_s);
+
 	return 0;
 }
 
@@ -2225,7 +2309,7 @@ static int sample_memory_bus_v1(struct target *target,
 		if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
 			/* Discard this batch (too much hassle to try to recover partial
 			 * data) and try again with a larger delay. */
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+			increase_bus_master_delay(info, &info->bus_master_read_delay);
 			dmi_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR | DM_SBCS_SBERROR);
 			riscv_batch_free(batch);
 			continue;
@@ -2283,6 +2367,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->set_register_buf = &riscv013_set_register_buf;
 	generic_info->select_current_hart = &riscv013_select_current_hart;
 	generic_info->is_halted = &riscv013_is_halted;
+	generic_info->get_hart_states = &riscv013_get_hart_states;
 	generic_info->resume_go = &riscv013_resume_go;
 	generic_info->step_current_hart = &riscv013_step_current_hart;
 	generic_info->on_halt = &riscv013_on_halt;
@@ -2320,6 +2405,8 @@ static int init_target(struct command_context *cmd_ctx,
 	info->bus_master_read_delay = 0;
 	info->bus_master_write_delay = 0;
 	info->ac_busy_delay = 0;
+	info->decay_batches = RISCV013_DECAY_MIN_BATCHES;
+	info->batch_scans = RISCV013_BATCH_MIN_SCANS;
 
 	/* Assume all these abstract commands are supported until we learn
 	 * otherwise.
@@ -2683,10 +2770,14 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	}
 
 	RISCV013_INFO(info);
-	target_addr_t next_address = address;
-	target_addr_t end_address = address + count * size;
-
-	while (next_address < end_address) {
+	/* index of the first word still to read, the address does not tell it
+	 * when all words come from the same address */
+	uint32_t next_index = 0;
+	unsigned int busy_retries = 0;
+
+	while (next_index < count) {
+		const uint32_t pass_start = next_index;
+		target_addr_t next_address = address + (increment ? next_index * size : 0);
 		uint32_t sbcs_write = set_field(0, DM_SBCS_SBREADONADDR, 1);
 		sbcs_write |= sb_sbaccess(size);
 		if (increment == size)
@@ -2709,60 +2800,66 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 		}
 
 		/* First value has been read, and is waiting for us to issue a DMI read
-		 * to get it. */
+		 * to get it. Reading sbdata0 starts the next bus read, so it comes
+		 * last for each word. All words but the last one are read in
+		 * batches. A DMI read that comes back busy was never performed, so
+		 * the word it was after is still latched: after dmireset the batch
+		 * simply continues from that word, without writing sbaddress again
+		 * (which would start an extra bus read). */
 
 		static int sbdata[4] = {DM_SBDATA0, DM_SBDATA1, DM_SBDATA2, DM_SBDATA3};
 		assert(size <= 16);
-		target_addr_t next_read = address - 1;
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			for (int j = (size - 1) / 4; j >= 0; j--) {
-				uint32_t value;
-				unsigned attempt = 0;
-				while (1) {
-					if (attempt++ > 100) {
-						LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								  next_read);
-						return ERROR_FAIL;
-					}
-					keep_alive();
-					dmi_status_t status = dmi_scan(target, NULL, &value,
-												   DMI_OP_READ, sbdata[j], 0, false);
-					if (status == DMI_STATUS_BUSY)
-						increase_dmi_busy_delay(target);
-					else if (status == DMI_STATUS_SUCCESS)
+		const int words = DIV_ROUND_UP(size, 4);
+		uint32_t i = next_index;
+		while (i + 1 < count) {
+			unsigned int busy_events = info->busy_events;
+			struct riscv_batch *batch = riscv_batch_alloc(target, info->batch_scans,
+					info->dmi_busy_delay + info->bus_master_read_delay);
+			if (!batch)
+				return ERROR_FAIL;
+
+			uint32_t first = i;
+			for (; i + 1 < count && riscv_batch_available_scans(batch) >= (size_t)words; i++)
+				for (int j = words - 1; j >= 0; j--)
+					riscv_batch_add_dmi_read(batch, sbdata[j]);
+
+			keep_alive();
+			if (batch_run(target, batch) != ERROR_OK) {
+				riscv_batch_free(batch);
+				return ERROR_FAIL;
+			}
+
+			bool dmi_busy = false;
+			uint32_t last = i;
+			size_t key = 0;
+			for (uint32_t k = first; k < last && !dmi_busy; k++) {
+				for (int j = words - 1; j >= 0; j--, key++) {
+					if (riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS) {
+						dmi_busy = true;
+						i = k;
 						break;
-					else
-						return ERROR_FAIL;
-				}
-				if (next_read != address - 1) {
-					buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-					log_memory_access(next_read, value, MIN(size, 4), true);
+					}
+					uint32_t value = riscv_batch_get_dmi_read_data(batch, key);
+					buf_set_u32(buffer + k * size + j * 4, 0, 8 * MIN(size, 4), value);
+					log_memory_access(address + k * size + j * 4, value, MIN(size, 4), true);
 				}
-				next_read = address + i * size + j * 4;
 			}
-		}
+			riscv_batch_free(batch);
 
-		uint32_t sbcs_read = 0;
-		if (count > 1) {
-			uint32_t value;
-			unsigned attempt = 0;
-			while (1) {
-				if (attempt++ > 100) {
+			if (dmi_busy) {
+				if (busy_retries++ > 100) {
 					LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								next_read);
+							address + i * size);
 					return ERROR_FAIL;
 				}
-				dmi_status_t status = dmi_scan(target, NULL, &value, DMI_OP_NOP, 0, 0, false);
-				if (status == DMI_STATUS_BUSY)
-					increase_dmi_busy_delay(target);
-				else if (status == DMI_STATUS_SUCCESS)
-					break;
-				else
-					return ERROR_FAIL;
+				increase_dmi_busy_delay(target);
+			} else {
+				batch_tune(target, busy_events);
 			}
-			buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-			log_memory_access(next_read, value, MIN(size, 4), true);
+		}
 
+		uint32_t sbcs_read = 0;
+		if (count > 1) {
 			/* "Writes to sbcs while sbbusy is high result in undefined behavior.
 			 * A debugger must not write to sbcs until it reads sbbusy as 0." */
 			if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
@@ -2788,14 +2885,19 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 			/* We read while the target was busy. Slow down and try again. */
 			if (dmi_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR) != ERROR_OK)
 				return ERROR_FAIL;
-			next_address = sb_read_address(target);
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+			/* without auto-increment there is no telling which reads of this
+			 * pass were lost, read them all again */
+			if (increment)
+				next_index = (sb_read_address(target) - address) / size;
+			else
+				next_index = pass_start;
+			increase_bus_master_delay(info, &info->bus_master_read_delay);
 			continue;
 		}
 
 		unsigned error = get_field(sbcs_read, DM_SBCS_SBERROR);
 		if (error == 0) {
-			next_address = end_address;
+			next_index = count;
 		} else {
 			/* Some error indicating the bus access failed, but not because of
 			 * something we did wrong. */
@@ -3157,7 +3259,8 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		 * dm_data0 contains[read_addr-size*2]
 		 */
 
-		struct riscv_batch *batch = riscv_batch_alloc(target, 32,
+		unsigned int busy_events = info->busy_events;
+		struct riscv_batch *batch = riscv_batch_alloc(target, info->batch_scans,
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3304,6 +3407,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		index = next_index;
 
 		riscv_batch_free(batch);
+		batch_tune(target, busy_events);
 	}
 
 	dmi_write(target, DM_ABSTRACTAUTO, 0);
@@ -3529,6 +3633,25 @@ static int read_memory_progbuf(struct target *target, target_addr_t address,
 	return result;
 }
 
+/* Record the throughput of a memory transfer. Small transfers are dominated by
+ * setup overhead and are not recorded. */
+static void note_throughput(struct target *target, struct duration *bench,
+		uint32_t bytes, bool read)
+{
+	RISCV013_INFO(info);
+
+	if (bytes < 1024 || duration_measure(bench) != ERROR_OK)
+		return;
+
+	unsigned int kib_per_s = duration_kbps(bench, bytes);
+	if (read)
+		info->read_kib_per_s = kib_per_s;
+	else
+		info->write_kib_per_s = kib_per_s;
+	LOG_DEBUG("%s %" PRIu32 " bytes at %u KiB/s", read ? "read" : "wrote", bytes,
+			kib_per_s);
+}
+
 static int read_memory(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment)
 {
@@ -3548,6 +3671,9 @@ static int read_memory(struct target *target, target_addr_t address,
 	char *sysbus_result = "disabled";
 	char *abstract_result = "disabled";
 
+	struct duration bench;
+	duration_start(&bench);
+
 	for (unsigned int i = 0; i < RISCV_NUM_MEM_ACCESS_METHODS; i++) {
 		int method = r->mem_access_methods[i];
 
@@ -3584,8 +3710,10 @@ static int read_memory(struct target *target, target_addr_t address,
 
 		log_mem_access_result(target, ret == ERROR_OK, method, true);
 
-		if (ret == ERROR_OK)
+		if (ret == ERROR_OK) {
+			note_throughput(target, &bench, size * count, true);
 			return ret;
+		}
 	}
 
 	LOG_ERROR("Target %s: Failed to read memory (addr=0x%" PRIx64 ")", target_name(target), address);
@@ -3664,9 +3792,10 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		LOG_DEBUG("transferring burst starting at address 0x%" TARGET_PRIxADDR,
 				next_address);
 
+		unsigned int busy_events = info->busy_events;
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
+				info->batch_scans,
 				info->dmi_busy_delay + info->bus_master_write_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3743,7 +3872,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			/* Clear the sticky error flag. */
 			dmi_write(target, DM_SBCS, sbcs | DM_SBCS_SBBUSYERROR);
 			/* Slow down before trying again. */
-			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
+			increase_bus_master_delay(info, &info->bus_master_write_delay);
 		}
 
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered) {
@@ -3781,6 +3910,8 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			/* Fail the whole operation */
 			return ERROR_FAIL;
 		}
+
+		batch_tune(target, busy_events);
 	}
 
 	return ERROR_OK;
@@ -3859,9 +3990,10 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 		LOG_DEBUG("transferring burst starting at address 0x%016" PRIx64,
 				cur_addr);
 
+		unsigned int busy_events = info->busy_events;
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
+				info->batch_scans,
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			goto error;
@@ -3938,6 +4070,7 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
 		if (info->cmderr == CMDERR_NONE && !dmi_busy_encountered) {
 			LOG_DEBUG("successful (partial?) memory write");
+			batch_tune(target, busy_events);
 		} else if (info->cmderr == CMDERR_BUSY || dmi_busy_encountered) {
 			if (info->cmderr == CMDERR_BUSY)
 				LOG_DEBUG("Memory write resulted in abstract command busy response.");
@@ -3994,6 +4127,9 @@ static int write_memory(struct target *target, target_addr_t address,
 	char *sysbus_result = "disabled";
 	char *abstract_result = "disabled";
 
+	struct duration bench;
+	duration_start(&bench);
+
 	for (unsigned int i = 0; i < RISCV_NUM_MEM_ACCESS_METHODS; i++) {
 		int method = r->mem_access_methods[i];
 
@@ -4030,8 +4166,10 @@ static int write_memory(struct target *target, target_addr_t address,
 
 		log_mem_access_result(target, ret == ERROR_OK, method, false);
 
-		if (ret == ERROR_OK)
+		if (ret == ERROR_OK) {
+			note_throughput(target, &bench, size * count, false);
 			return ret;
+		}
 	}
 
 	LOG_ERROR("Target %s: Failed to write memory (addr=0x%" PRIx64 ")", target_name(target), address);
@@ -4188,14 +4326,266 @@ static int select_prepped_harts(struct target *target, bool *use_hasel)
 		return ERROR_OK;
 	}
 
+	/* Program all windows in one batch, falling back on single writes if the
+	 * DMI reported busy. */
+	riscv013_info_t *info = get_info(target);
+	struct riscv_batch *batch = riscv_batch_alloc(target, 2 * hawindow_count + 1,
+			info->dmi_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
 	for (unsigned i = 0; i < hawindow_count; i++) {
-		if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOWSEL, i);
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOW, hawindow[i]);
+	}
+	size_t key = riscv_batch_add_dmi_read(batch, DM_HAWINDOWSEL);
+	int result = riscv_batch_run(batch);
+	unsigned status = riscv_batch_get_dmi_read_op(batch, key);
+	riscv_batch_free(batch);
+	if (result != ERROR_OK)
+		return result;
+
+	if (status != DMI_STATUS_SUCCESS) {
+		increase_dmi_busy_delay(target);
+		for (unsigned i = 0; i < hawindow_count; i++) {
+			if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
+				return ERROR_FAIL;
+			if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+	}
+
+	*use_hasel = true;
+	return ERROR_OK;
+}
+
+/* Number of targets attached to this DM. */
+static unsigned int dm013_target_count(dm013_info_t *dm)
+{
+	unsigned int count = 0;
+	target_list_t *entry;
+	list_for_each_entry(entry, &dm->target_list, list)
+		count++;
+	return count;
+}
+
+/* Store the harts on this DM that belong to the SMP group of target in harts,
+ * optionally only the prepped ones, with target itself last. Returns the
+ * number of harts stored. */
+static unsigned int dm013_collect_harts(struct target *target, dm013_info_t *dm,
+		struct target **harts, bool prepped_only)
+{
+	unsigned int count = 0;
+	target_list_t *entry;
+	list_for_each_entry(entry, &dm->target_list, list) {
+		struct target *t = entry->target;
+		if (t == target || !target->smp || t->smp != target->smp)
+			continue;
+		if (prepped_only && !riscv_info(t)->prepped)
+			continue;
+		harts[count++] = t;
+	}
+	harts[count++] = target;
+	return count;
+}
+
+/* Select each hart in turn, writing dmcontrol[i] combined with its hartsel,
+ * and read back its dmstatus, all in a single batch. ok[i] tells whether
+ * dmstatus[i] was read; once the DMI reports busy the rest of the batch is
+ * lost, so the caller has to retry the harts that are not ok. */
+static int dm013_batch_dmstatus(struct target *target, dm013_info_t *dm,
+		struct target **harts, unsigned int count, const uint32_t *dmcontrol,
+		uint32_t *dmstatus, bool *ok)
+{
+	riscv013_info_t *info = get_info(target);
+	struct riscv_batch *batch = riscv_batch_alloc(target, 2 * count,
+			info->dmi_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		riscv_batch_add_dmi_write(batch, DM_DMCONTROL,
+				set_hartsel(dmcontrol[i], riscv_info(harts[i])->current_hartid));
+		riscv_batch_add_dmi_read(batch, DM_DMSTATUS);
+	}
+
+	int result = riscv_batch_run(batch);
+	bool busy = false;
+	for (unsigned int i = 0; i < count; i++) {
+		ok[i] = result == ERROR_OK &&
+			riscv_batch_get_dmi_read_op(batch, i) == DMI_STATUS_SUCCESS;
+		if (ok[i])
+			dmstatus[i] = riscv_batch_get_dmi_read_data(batch, i);
+		else if (result == ERROR_OK)
+			busy = true;
+	}
+	riscv_batch_free(batch);
+
+	if (busy)
+		increase_dmi_busy_delay(target);
+
+	/* The last hart in the list is left selected. */
+	if (result == ERROR_OK && !busy)
+		dm->current_hartid = riscv_info(harts[count - 1])->current_hartid;
+	else
+		dm->current_hartid = -1;
+
+	return result;
+}
+
+/* Halt or resume (request is HALTREQ or RESUMEREQ) several harts on a DM that
+ * has no hart array mask, selecting them one after another within batches
+ * and collecting their dmstatus in the same batches. */
+static int dm013_group_request(struct target *target, dm013_info_t *dm,
+		struct target **harts, unsigned int count, uint32_t request)
+{
+	bool halt = request == DM_DMCONTROL_HALTREQ;
+	struct target *pending[count];
+	unsigned int index[count];
+	uint32_t dmcontrol[count];
+	uint32_t dmstatus[count];
+	bool ok[count];
+	bool requested[count];
+	bool done[count];
+
+	LOG_DEBUG("%s %u harts", halt ? "halting" : "resuming", count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		riscv_info(harts[i])->prepped = false;
+		requested[i] = false;
+		done[i] = false;
+	}
+
+	for (unsigned int round = 0; round < 256; round++) {
+		unsigned int n = 0;
+		for (unsigned int i = 0; i < count; i++) {
+			if (done[i])
+				continue;
+			index[n] = i;
+			pending[n] = harts[i];
+			dmcontrol[n] = DM_DMCONTROL_DMACTIVE;
+			/* Writing 0 to haltreq would cancel the request, while a
+			 * second resumereq would clear resumeack again. */
+			if (halt || !requested[i])
+				dmcontrol[n] |= request;
+			n++;
+		}
+		if (!n)
+			break;
+
+		if (dm013_batch_dmstatus(target, dm, pending, n, dmcontrol, dmstatus,
+					ok) != ERROR_OK)
 			return ERROR_FAIL;
-		if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
+
+		for (unsigned int j = 0; j < n; j++) {
+			if (!ok[j])
+				continue;
+			unsigned int i = index[j];
+			requested[i] = true;
+			if (halt)
+				done[i] = get_field(dmstatus[j], DM_DMSTATUS_ALLHALTED);
+			else
+				done[i] = get_field(dmstatus[j], DM_DMSTATUS_ALLRESUMEACK) ||
+					!get_field(dmstatus[j], DM_DMSTATUS_ALLHALTED);
+		}
+	}
+
+	if (halt) {
+		/* Clear haltreq again on every hart. */
+		for (unsigned int i = 0; i < count; i++)
+			dmcontrol[i] = DM_DMCONTROL_DMACTIVE;
+		if (dm013_batch_dmstatus(target, dm, harts, count, dmcontrol, dmstatus,
+					ok) != ERROR_OK)
 			return ERROR_FAIL;
+		for (unsigned int i = 0; i < count; i++) {
+			if (ok[i])
+				continue;
+			uint32_t value = set_hartsel(DM_DMCONTROL_DMACTIVE,
+					riscv_info(harts[i])->current_hartid);
+			if (dmi_write(target, DM_DMCONTROL, value) != ERROR_OK)
+				return ERROR_FAIL;
+			dm->current_hartid = riscv_info(harts[i])->current_hartid;
+		}
+	}
+
+	int result = ERROR_OK;
+	for (unsigned int i = 0; i < count; i++) {
+		struct target *t = harts[i];
+		if (!done[i]) {
+			LOG_ERROR("unable to %s hart %d", halt ? "halt" : "resume",
+					riscv_info(t)->current_hartid);
+			result = ERROR_FAIL;
+		} else if (halt) {
+			t->state = TARGET_HALTED;
+			if (t->debug_reason == DBG_REASON_NOTHALTED)
+				t->debug_reason = DBG_REASON_DBGRQ;
+		}
+	}
+
+	return result;
+}
+
+/* Halt or resume all prepped harts of target's DM in batches, if the DM has no
+ * hart array mask and there is more than one such hart. */
+static int dm013_group_request_prepped(struct target *target, uint32_t request,
+		bool *handled)
+{
+	*handled = false;
+
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+	if (dm->hasel_supported)
+		return ERROR_OK;
+
+	struct target *harts[dm013_target_count(dm)];
+	unsigned int count = dm013_collect_harts(target, dm, harts, true);
+	if (count < 2)
+		return ERROR_OK;
+
+	*handled = true;
+	return dm013_group_request(target, dm, harts, count, request);
+}
+
+static int riscv013_get_hart_states(struct target *target)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	struct target *harts[dm013_target_count(dm)];
+	unsigned int count = dm013_collect_harts(target, dm, harts, false);
+	if (count < 2)
+		return ERROR_OK;
+
+	/* Keep dmactive and ndmreset, drop everything that acts on harts. */
+	uint32_t value;
+	if (dmi_read(target, &value, DM_DMCONTROL) != ERROR_OK)
+		return ERROR_FAIL;
+	value &= DM_DMCONTROL_DMACTIVE | DM_DMCONTROL_NDMRESET;
+
+	uint32_t dmcontrol[count];
+	uint32_t dmstatus[count];
+	bool ok[count];
+	for (unsigned int i = 0; i < count; i++)
+		dmcontrol[i] = value;
+
+	if (dm013_batch_dmstatus(target, dm, harts, count, dmcontrol, dmstatus,
+				ok) != ERROR_OK)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct riscv_info *r = riscv_info(harts[i]);
+		/* Leave anything unusual to riscv013_is_halted(). */
+		if (!ok[i] || !get_field(dmstatus[i], DM_DMSTATUS_AUTHENTICATED) ||
+				(dmstatus[i] & (DM_DMSTATUS_ANYUNAVAIL |
+					DM_DMSTATUS_ANYNONEXISTENT | DM_DMSTATUS_ANYHAVERESET)))
+			r->hart_sample = RISCV_HART_SAMPLE_UNCERTAIN;
+		else if (get_field(dmstatus[i], DM_DMSTATUS_ALLHALTED))
+			r->hart_sample = RISCV_HART_SAMPLE_HALTED;
+		else
+			r->hart_sample = RISCV_HART_SAMPLE_RUNNING;
 	}
 
-	*use_hasel = true;
 	return ERROR_OK;
 }
 
@@ -4206,6 +4596,12 @@ static int riscv013_halt_prep(struct target *target)
 
 static int riscv013_halt_go(struct target *target)
 {
+	bool handled;
+	int result = dm013_group_request_prepped(target, DM_DMCONTROL_HALTREQ,
+			&handled);
+	if (handled || result != ERROR_OK)
+		return result;
+
 	bool use_hasel = false;
 	if (select_prepped_harts(target, &use_hasel) != ERROR_OK)
 		return ERROR_FAIL;
@@ -4258,6 +4654,12 @@ static int riscv013_halt_go(struct target *target)
 
 static int riscv013_resume_go(struct target *target)
 {
+	bool handled;
+	int result = dm013_group_request_prepped(target, DM_DMCONTROL_RESUMEREQ,
+			&handled);
+	if (handled || result != ERROR_OK)
+		return result;
+
 	bool use_hasel = false;
 	if (select_prepped_harts(target, &use_hasel) != ERROR_OK)
 		return ERROR_FAIL;
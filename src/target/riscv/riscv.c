@@ -2085,14 +2085,30 @@ enum riscv_poll_hart {
 static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid)
 {
 	RISCV_INFO(r);
-	if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
-		return RPH_ERROR;
+	enum riscv_hart_sample sample = r->hart_sample;
+	r->hart_sample = RISCV_HART_SAMPLE_NONE;
+
+	bool halted;
+	if (sample == RISCV_HART_SAMPLE_RUNNING || sample == RISCV_HART_SAMPLE_HALTED) {
+		/* Already read by get_hart_states(); only select the hart when there
+		 * is an event to handle. */
+		halted = sample == RISCV_HART_SAMPLE_HALTED;
+		LOG_DEBUG("sampled hart %d, halted=%d, target->state=%d", hartid,
+				halted, target->state);
+		if (halted ? target->state == TARGET_HALTED : target->state == TARGET_RUNNING)
+			return RPH_NO_CHANGE;
+		if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
+			return RPH_ERROR;
+	} else {
+		if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
+			return RPH_ERROR;
 
-	LOG_DEBUG("polling hart %d, target->state=%d", hartid, target->state);
+		LOG_DEBUG("polling hart %d, target->state=%d", hartid, target->state);
+		halted = riscv_is_halted(target);
+	}
 
 	/* If OpenOCD thinks we're running but this hart is halted then it's time
 	 * to raise an event. */
-	bool halted = riscv_is_halted(target);
 	if (target->state != TARGET_HALTED && halted) {
 		LOG_DEBUG("  triggered a halt");
 		r->on_halt(target);
@@ -2190,6 +2206,19 @@ int riscv_openocd_poll(struct target *target)
 		unsigned should_remain_halted = 0;
 		unsigned should_resume = 0;
 		struct target_list *list;
+
+		/* Collect the state of all harts with as few DMI round trips as the
+		 * debug modules allow. Failures fall back on per hart reads. */
+		foreach_smp_target(list, target->smp_targets)
+			riscv_info(list->target)->hart_sample = RISCV_HART_SAMPLE_NONE;
+		foreach_smp_target(list, target->smp_targets) {
+			struct target *t = list->target;
+			struct riscv_info *r = riscv_info(t);
+			if (r->get_hart_states && r->hart_sample == RISCV_HART_SAMPLE_NONE &&
+					target_was_examined(t))
+				r->get_hart_states(t);
+		}
+
 		foreach_smp_target(list, target->smp_targets) {
 			struct target *t = list->target;
 			struct riscv_info *r = riscv_info(t);
@@ -49,6 +49,15 @@ enum riscv_mem_access_method {
 	RISCV_MEM_ACCESS_ABSTRACT
 };
 
+/* Hart state collected for many harts at once by get_hart_states(). */
+enum riscv_hart_sample {
+	RISCV_HART_SAMPLE_NONE,
+	RISCV_HART_SAMPLE_RUNNING,
+	RISCV_HART_SAMPLE_HALTED,
+	/* Read, but needs a closer look (reset, unavailable, DMI error). */
+	RISCV_HART_SAMPLE_UNCERTAIN
+};
+
 enum riscv_halt_reason {
 	RISCV_HALT_INTERRUPT,
 	RISCV_HALT_BREAKPOINT,
@@ -136,6 +145,9 @@ struct riscv_info {
 	bool prepped;
 	/* This target was selected using hasel. */
 	bool selected;
+	/* State of this hart as read by get_hart_states(), used once by the
+	 * next poll. */
+	enum riscv_hart_sample hart_sample;
 
 	/* Helper functions that target the various RISC-V debug spec
 	 * implementations. */
@@ -146,6 +158,9 @@ struct riscv_info {
 			const uint8_t *buf);
 	int (*select_current_hart)(struct target *target);
 	bool (*is_halted)(struct target *target);
+	/* Read the state of all harts of this target's SMP group that share
+	 * its Debug Module in one go, storing it in their hart_sample. */
+	int (*get_hart_states)(struct target *target);
 	/* Resume this target, as well as every other prepped target that can be
 	 * resumed near-simultaneously. Clear the prepped flag on any target that
 	 * was resumed. */
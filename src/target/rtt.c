@@ -13,6 +13,7 @@
 #include <helper/log.h>
 #include <helper/binarybuffer.h>
 #include <helper/command.h>
+#include <helper/metrics.h>
 #include <rtt/rtt.h>
 #include <target/rtt.h>
 
@@ -404,6 +405,8 @@ int target_rtt_read_callback(struct target *target,
 			return ret;
 		}
 
+		metrics_add(METRICS_RTT_BYTES, "dir=\"up\"", length);
+
 		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
 			sink->read(i, buffer, length, sink->user_data);
 	}
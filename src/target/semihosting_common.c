@@ -39,6 +39,8 @@
 
 #include <helper/binarybuffer.h>
 #include <helper/log.h>
+#include <helper/metrics.h>
+#include <helper/time_support.h>
 #include <server/gdb_server.h>
 #include <sys/stat.h>
 
@@ -137,6 +139,14 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
 	semihosting->basedir = NULL;
+	semihosting->io_buffer = NULL;
+	semihosting->io_buffer_size = 0;
+	semihosting->write_behind_buffer = NULL;
+	semihosting->write_behind_size = 0;
+	semihosting->write_behind_len = 0;
+	semihosting->write_behind_fd = -1;
+	semihosting->write_behind_errno = 0;
+	semihosting->write_behind_time = 0;
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -153,6 +163,124 @@ int semihosting_common_init(struct target *target, void *setup,
 	return ERROR_OK;
 }
 
+/* Pending write-behind data older than this is flushed by a timer. */
+#define SEMIHOSTING_WRITE_BEHIND_MS 100
+
+/**
+ * Write the pending write-behind data to its file. A failure is kept in
+ * write_behind_errno, to be reported by the next SYS_WRITE or SYS_CLOSE
+ * on that handle.
+ */
+static void semihosting_write_behind_flush(struct semihosting *semihosting)
+{
+	size_t done = 0;
+
+	while (done < semihosting->write_behind_len) {
+		ssize_t n = write(semihosting->write_behind_fd,
+			semihosting->write_behind_buffer + done,
+			semihosting->write_behind_len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			semihosting->write_behind_errno = errno;
+			LOG_ERROR("semihosting: deferred write to handle %d failed: %s",
+				semihosting->write_behind_fd, strerror(errno));
+			break;
+		}
+		done += n;
+	}
+
+	LOG_DEBUG("write(%d, %zu bytes) flushed", semihosting->write_behind_fd, done);
+	semihosting->write_behind_len = 0;
+}
+
+static int semihosting_write_behind_timer(void *priv)
+{
+	struct target *target = priv;
+	struct semihosting *semihosting = target->semihosting;
+
+	if (semihosting->write_behind_len &&
+			timeval_ms() - semihosting->write_behind_time >= SEMIHOSTING_WRITE_BEHIND_MS)
+		semihosting_write_behind_flush(semihosting);
+
+	return ERROR_OK;
+}
+
+/**
+ * Resize the write-behind buffer, 0 disables it. Pending data is flushed
+ * first.
+ */
+static int semihosting_write_behind_set_size(struct target *target, size_t size)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (semihosting->write_behind_len)
+		semihosting_write_behind_flush(semihosting);
+
+	if (size == semihosting->write_behind_size)
+		return ERROR_OK;
+
+	if (!size) {
+		target_unregister_timer_callback(semihosting_write_behind_timer, target);
+		free(semihosting->write_behind_buffer);
+		semihosting->write_behind_buffer = NULL;
+		semihosting->write_behind_size = 0;
+		return ERROR_OK;
+	}
+
+	uint8_t *buf = realloc(semihosting->write_behind_buffer, size);
+	if (!buf) {
+		LOG_ERROR("out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (!semihosting->write_behind_size)
+		target_register_timer_callback(semihosting_write_behind_timer,
+			SEMIHOSTING_WRITE_BEHIND_MS, TARGET_TIMER_TYPE_PERIODIC, target);
+
+	semihosting->write_behind_buffer = buf;
+	semihosting->write_behind_size = size;
+	return ERROR_OK;
+}
+
+/**
+ * Return the reusable SYS_READ/SYS_WRITE transfer buffer, grown to at
+ * least @a size bytes, or NULL when out of memory.
+ */
+static uint8_t *semihosting_get_io_buffer(struct semihosting *semihosting, size_t size)
+{
+	/* never hand out NULL for zero length transfers */
+	size = MAX(size, 1);
+
+	if (size > semihosting->io_buffer_size) {
+		uint8_t *buf = realloc(semihosting->io_buffer, size);
+		if (!buf)
+			return NULL;
+		semihosting->io_buffer = buf;
+		semihosting->io_buffer_size = size;
+	}
+
+	return semihosting->io_buffer;
+}
+
+/**
+ * Release the semihosting data of a target, flushing pending
+ * write-behind data.
+ */
+void semihosting_common_free(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting)
+		return;
+
+	semihosting_write_behind_set_size(target, 0);
+	free(semihosting->io_buffer);
+	free(semihosting->basedir);
+	free(semihosting);
+	target->semihosting = NULL;
+}
+
 struct semihosting_tcp_service {
 	struct semihosting *semihosting;
 	char *name;
@@ -358,19 +486,9 @@ const char *semihosting_opcode_to_str(const uint64_t opcode)
 	}
 }
 
-/**
- * Portable implementation of ARM semihosting calls.
- * Performs the currently pending semihosting operation
- * encoded in target->semihosting.
- */
-int semihosting_common(struct target *target)
+static int semihosting_common_op(struct target *target)
 {
 	struct semihosting *semihosting = target->semihosting;
-	if (!semihosting) {
-		/* Silently ignore if the semihosting field was not set. */
-		return ERROR_OK;
-	}
-
 	struct gdb_fileio_info *fileio_info = target->fileio_info;
 
 	/*
@@ -466,6 +584,15 @@ int semihosting_common(struct target *target)
 					if (semihosting->result == -1)
 						semihosting->sys_errno = errno;
 					LOG_DEBUG("close(%d)=%" PRId64, fd, semihosting->result);
+					if (fd == semihosting->write_behind_fd) {
+						/* a deferred write failed, the file is incomplete */
+						if (semihosting->write_behind_errno) {
+							semihosting->result = -1;
+							semihosting->sys_errno = semihosting->write_behind_errno;
+							semihosting->write_behind_errno = 0;
+						}
+						semihosting->write_behind_fd = -1;
+					}
 				}
 			}
 			break;
@@ -1042,7 +1169,7 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
+					uint8_t *buf = semihosting_get_io_buffer(semihosting, len);
 					if (!buf) {
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
@@ -1057,15 +1184,14 @@ int semihosting_common(struct target *target)
 							retval = target_write_buffer(target, addr,
 									semihosting->result,
 									buf);
-							if (retval != ERROR_OK) {
-								free(buf);
+							if (retval != ERROR_OK)
 								return retval;
-							}
+							metrics_add(METRICS_SEMIHOSTING_BYTES, "dir=\"read\"",
+								semihosting->result);
 							/* the number of bytes NOT filled in */
 							semihosting->result = len -
 								semihosting->result;
 						}
-						free(buf);
 					}
 				}
 			}
@@ -1378,16 +1504,50 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
+					/* Only plain files opened with SYS_OPEN are written behind */
+					bool behind = semihosting->write_behind_size &&
+						fd > 2 && len <= semihosting->write_behind_size &&
+						!semihosting_is_redirected(semihosting, fd) &&
+						(!semihosting->write_behind_errno ||
+						 fd == semihosting->write_behind_fd);
+
+					if (semihosting->write_behind_len &&
+							(!behind || fd != semihosting->write_behind_fd ||
+							 semihosting->write_behind_len + len > semihosting->write_behind_size))
+						semihosting_write_behind_flush(semihosting);
+
+					if (semihosting->write_behind_errno && fd == semihosting->write_behind_fd) {
+						/* report a failed deferred write, nothing written */
+						semihosting->result = len;
+						semihosting->sys_errno = semihosting->write_behind_errno;
+						semihosting->write_behind_errno = 0;
+						break;
+					}
+
+					if (behind) {
+						/* copy target data straight into the write-behind buffer */
+						retval = target_read_buffer(target, addr, len,
+							semihosting->write_behind_buffer + semihosting->write_behind_len);
+						if (retval != ERROR_OK)
+							return retval;
+						if (!semihosting->write_behind_len)
+							semihosting->write_behind_time = timeval_ms();
+						semihosting->write_behind_fd = fd;
+						semihosting->write_behind_len += len;
+						metrics_add(METRICS_SEMIHOSTING_BYTES, "dir=\"write\"", len);
+						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu) deferred", fd, addr, len);
+						semihosting->result = 0;
+						break;
+					}
+
+					uint8_t *buf = semihosting_get_io_buffer(semihosting, len);
 					if (!buf) {
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
 					} else {
 						retval = target_read_buffer(target, addr, len, buf);
-						if (retval != ERROR_OK) {
-							free(buf);
+						if (retval != ERROR_OK)
 							return retval;
-						}
 						semihosting->result = semihosting_write(semihosting, fd, buf, len);
 						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
 							fd,
@@ -1395,13 +1555,13 @@ int semihosting_common(struct target *target)
 							len,
 							semihosting->result);
 						if (semihosting->result >= 0) {
+							metrics_add(METRICS_SEMIHOSTING_BYTES, "dir=\"write\"",
+								semihosting->result);
 							/* The number of bytes that are NOT written.
 							 * */
 							semihosting->result = len -
 								semihosting->result;
 						}
-
-						free(buf);
 					}
 				}
 			}
@@ -1646,6 +1806,40 @@ int semihosting_common(struct target *target)
 /* -------------------------------------------------------------------------
  * Local functions. */
 
+/**
+ * Portable implementation of ARM semihosting calls.
+ * Performs the currently pending semihosting operation
+ * encoded in target->semihosting.
+ */
+int semihosting_common(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		/* Silently ignore if the semihosting field was not set. */
+		return ERROR_OK;
+	}
+
+	/* Everything but another host write to the same file ends write-behind */
+	if (semihosting->write_behind_len &&
+			(semihosting->op != SEMIHOSTING_SYS_WRITE || semihosting->is_fileio))
+		semihosting_write_behind_flush(semihosting);
+
+	struct duration call_time;
+	char labels[48];
+
+	duration_start(&call_time);
+	int retval = semihosting_common_op(target);
+	duration_measure(&call_time);
+
+	if (metrics_enabled) {
+		snprintf(labels, sizeof(labels), "op=\"%s\"",
+			semihosting_opcode_to_str(semihosting->op));
+		metrics_observe(METRICS_SEMIHOSTING_CALL_SECONDS, labels, &call_time);
+	}
+
+	return retval;
+}
+
 static int semihosting_common_fileio_info(struct target *target,
 	struct gdb_fileio_info *fileio_info)
 {
@@ -1863,6 +2057,9 @@ COMMAND_HANDLER(handle_common_semihosting_command)
 
 		/* FIXME never let that "catch" be dropped! (???) */
 		semihosting->is_active = is_active;
+
+		if (!is_active && semihosting->write_behind_len)
+			semihosting_write_behind_flush(semihosting);
 	}
 
 	command_print(CMD, "semihosting is %s",
@@ -2112,6 +2309,44 @@ COMMAND_HANDLER(handle_common_semihosting_basedir_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_write_behind_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		unsigned int size = 0;
+
+		if (strcmp(CMD_ARGV[0], "off") != 0)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+
+		int retval = semihosting_write_behind_set_size(target, size);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (semihosting->write_behind_size)
+		command_print(CMD, "semihosting write-behind buffer: %zu bytes",
+			semihosting->write_behind_size);
+	else
+		command_print(CMD, "semihosting write-behind buffer: off");
+
+	return ERROR_OK;
+}
+
 const struct command_registration semihosting_common_handlers[] = {
 	{
 		.name = "semihosting",
@@ -2162,5 +2397,12 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "[dir]",
 		.help = "set the base directory for semihosting I/O operations",
 	},
+	{
+		.name = "semihosting_write_behind",
+		.handler = handle_common_semihosting_write_behind_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[size|'off']",
+		.help = "buffer semihosting writes to files on the host",
+	},
 	COMMAND_REGISTRATION_DONE
 };
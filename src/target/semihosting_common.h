@@ -177,6 +177,24 @@ struct semihosting {
 	/** Base directory for semihosting I/O operations. */
 	char *basedir;
 
+	/** Reusable host buffer for SYS_READ and SYS_WRITE data, grown on demand. */
+	uint8_t *io_buffer;
+	size_t io_buffer_size;
+
+	/**
+	 * Host side write-behind buffer for SYS_WRITE to files opened with
+	 * SYS_OPEN. Data is kept back until another operation, a write to a
+	 * different handle, a full buffer or the periodic timer flushes it.
+	 * A write error found while flushing is reported by the next SYS_WRITE
+	 * or SYS_CLOSE on the same handle. Disabled when size is 0.
+	 */
+	uint8_t *write_behind_buffer;
+	size_t write_behind_size;
+	size_t write_behind_len;
+	int write_behind_fd;
+	int write_behind_errno;
+	int64_t write_behind_time;
+
 	/**
 	 * Target's extension of semihosting user commands.
 	 * @returns ERROR_NOT_IMPLEMENTED when user command is not handled, otherwise
@@ -197,6 +215,7 @@ const char *semihosting_opcode_to_str(uint64_t opcode);
 
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
+void semihosting_common_free(struct target *target);
 int semihosting_common(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
@@ -31,6 +31,7 @@
 #endif
 
 #include <helper/align.h>
+#include <helper/crc32.h>
 #include <helper/nvp.h>
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
@@ -48,6 +49,7 @@
 #include "arm_cti.h"
 #include "smp.h"
 #include "semihosting_common.h"
+#include "memory_sample.h"
 
 /* default halt wait timeout (ms) */
 #define DEFAULT_HALT_TIMEOUT 5000
@@ -1273,6 +1275,7 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	rtos_memory_written(target);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1287,6 +1290,7 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	rtos_memory_written(target);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -2183,13 +2187,13 @@ static void target_destroy(struct target *target)
 {
 	breakpoint_remove_all(target);
 	watchpoint_remove_all(target);
+	free(target->breakpoint_index);
 
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
-		free(target->semihosting->basedir);
-	free(target->semihosting);
+	semihosting_common_free(target);
+	memory_sample_free(target);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2360,6 +2364,7 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	rtos_memory_written(target);
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -3692,6 +3697,9 @@ COMMAND_HANDLER(handle_load_image_command)
 
 }
 
+/* dump_image reads target memory in chunks of this size */
+#define DUMP_IMAGE_CHUNK_SIZE	(64 * 1024)
+
 COMMAND_HANDLER(handle_dump_image_command)
 {
 	struct fileio *fileio;
@@ -3700,6 +3708,14 @@ COMMAND_HANDLER(handle_dump_image_command)
 	target_addr_t address, size;
 	struct duration bench;
 	struct target *target = get_current_target(CMD_CTX);
+	bool do_crc = false;
+	uint32_t crc = 0xffffffff;
+
+	if (CMD_ARGC == 4 && strcmp(CMD_ARGV[0], "crc32") == 0) {
+		do_crc = true;
+		CMD_ARGV++;
+		CMD_ARGC--;
+	}
 
 	if (CMD_ARGC != 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
@@ -3707,7 +3723,7 @@ COMMAND_HANDLER(handle_dump_image_command)
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
+	uint32_t buf_size = (size > DUMP_IMAGE_CHUNK_SIZE) ? DUMP_IMAGE_CHUNK_SIZE : size;
 	buffer = malloc(buf_size);
 	if (!buffer)
 		return ERROR_FAIL;
@@ -3731,8 +3747,13 @@ COMMAND_HANDLER(handle_dump_image_command)
 		if (retval != ERROR_OK)
 			break;
 
+		/* hash the chunk while it is at hand, saves a second pass */
+		if (do_crc)
+			crc = crc32_le(CRC32_POLY_LE, crc, buffer, this_run_size);
+
 		size -= this_run_size;
 		address += this_run_size;
+		keep_alive();
 	}
 
 	free(buffer);
@@ -3745,6 +3766,8 @@ COMMAND_HANDLER(handle_dump_image_command)
 		command_print(CMD,
 				"dumped %zu bytes in %fs (%0.3f KiB/s)", filesize,
 				duration_elapsed(&bench), duration_kbps(&bench, filesize));
+		if (do_crc)
+			command_print(CMD, "crc32 0x%08" PRIx32, ~crc);
 	}
 
 	retvaltemp = fileio_close(fileio);
@@ -5694,6 +5717,9 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "invoke handler for specified event",
 		.usage = "event_name",
 	},
+	{
+		.chain = memory_sample_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -5795,6 +5821,7 @@ static int target_create(struct jim_getopt_info *goi)
 	target->debug_reason        = DBG_REASON_UNDEFINED;
 	target->reg_cache           = NULL;
 	target->breakpoints         = NULL;
+	target->breakpoint_index    = NULL;
 	target->watchpoints         = NULL;
 	target->next                = NULL;
 	target->arch_info           = NULL;
@@ -6697,7 +6724,7 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "dump_image",
 		.handler = handle_dump_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "filename address size",
+		.usage = "['crc32'] filename address size",
 	},
 	{
 		.name = "verify_image_checksum",
@@ -157,6 +157,7 @@ struct target {
 	enum target_state state;			/* the current backend-state (running, halted, ...) */
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
+	struct breakpoint **breakpoint_index;	/* breakpoints hashed by address */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
@@ -207,6 +208,9 @@ struct target {
 
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
+
+	/* Periodic sampling of memory locations, see memory_sample.c */
+	struct memory_sample *memory_sample;
 };
 
 struct target_list {
@@ -1275,6 +1275,7 @@ void x86_32_common_reset_breakpoints_watchpoints(struct target *t)
 	struct breakpoint *next_b;
 	struct watchpoint *next_w;
 
+	breakpoint_index_clear(t);
 	while (t->breakpoints) {
 		next_b = t->breakpoints->next;
 		free(t->breakpoints->orig_instr);
@@ -428,9 +428,11 @@ static inline bool xtensa_is_dcacheable(struct xtensa *xtensa, target_addr_t add
 	       xtensa_is_cacheable(&xtensa->core_config->dcache, &xtensa->core_config->srom, address);
 }
 
+static int xtensa_fetch_lazy_regs(struct target *target);
+
 static int xtensa_core_reg_get(struct reg *reg)
 {
-	/* We don't need this because we read all registers on halt anyway. */
+	/* Registers are read on halt, only the lazy ones are left to fetch here. */
 	struct xtensa *xtensa = (struct xtensa *)reg->arch_info;
 	struct target *target = xtensa->target;
 
@@ -444,6 +446,8 @@ static int xtensa_core_reg_get(struct reg *reg)
 		}
 		return ERROR_COMMAND_ARGUMENT_INVALID;
 	}
+	if (!reg->valid && xtensa->lazy_regs_pending)
+		return xtensa_fetch_lazy_regs(target);
 	return ERROR_OK;
 }
 
@@ -675,6 +679,11 @@ static int xtensa_write_dirty_registers(struct target *target)
 		xtensa->nx_reg_idx[XT_NX_REG_IDX_MS] : reg_list_size;
 	xtensa_reg_val_t ms = 0;
 	bool restore_ms = false;
+	uint32_t wb_idx = (xtensa->core_config->core_type == XT_LX) ?
+		XT_REG_IDX_WINDOWBASE : xtensa->nx_reg_idx[XT_NX_REG_IDX_WB];
+	/* A3 is read back below unless the cache still holds it */
+	bool a3_cached = reg_list[XT_REG_IDX_A3].valid &&
+		!(xtensa->core_config->windowed && reg_list[wb_idx].dirty);
 
 	LOG_TARGET_DEBUG(target, "start");
 
@@ -745,7 +754,10 @@ static int xtensa_write_dirty_registers(struct target *target)
 	}
 
 	preserve_a3 = (xtensa->core_config->windowed) || (xtensa->core_config->core_type == XT_NX);
-	if (preserve_a3) {
+	if (preserve_a3 && a3_cached) {
+		/* A3 is restored from the cache, saving a queue execution */
+		a3 = xtensa_reg_get(target, XT_REG_IDX_A3);
+	} else if (preserve_a3) {
 		/* Save (windowed) A3 for scratch use */
 		xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_queue_dbg_reg_read(xtensa, XDMREG_DDR, a3_buf);
@@ -761,8 +773,6 @@ static int xtensa_write_dirty_registers(struct target *target)
 		if (res != ERROR_OK)
 			return res;
 		/* Grab the windowbase, we need it. */
-		uint32_t wb_idx = (xtensa->core_config->core_type == XT_LX) ?
-			XT_REG_IDX_WINDOWBASE : xtensa->nx_reg_idx[XT_NX_REG_IDX_WB];
 		windowbase = xtensa_reg_get(target, wb_idx);
 		if (xtensa->core_config->core_type == XT_NX)
 			windowbase = (windowbase & XT_WB_P_MSK) >> XT_WB_P_SHIFT;
@@ -1071,9 +1081,11 @@ void xtensa_reg_set(struct target *target, enum xtensa_reg_id reg_id, xtensa_reg
 {
 	struct xtensa *xtensa = target_to_xtensa(target);
 	struct reg *reg = &xtensa->core_cache->reg_list[reg_id];
-	if (xtensa_reg_get_value(reg) == value)
+	/* a lazy register not fetched yet must be written back whatever its cached value */
+	if (reg->valid && xtensa_reg_get_value(reg) == value)
 		return;
 	xtensa_reg_set_value(reg, value);
+	reg->valid = true;
 }
 
 /* Set Ax (XT_REG_RELGEN) register along with its underlying ARx (XT_REG_GENERAL) */
@@ -1232,6 +1244,7 @@ int xtensa_fetch_all_regs(struct target *target)
 	}
 
 	LOG_TARGET_DEBUG(target, "start");
+	xtensa->lazy_regs_pending = false;
 
 	/* Save (windowed) A3 so cache matches physical AR3; A3 usable as scratch */
 	xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, XT_SR_DDR, XT_REG_A3));
@@ -1292,38 +1305,24 @@ int xtensa_fetch_all_regs(struct target *target)
 		xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, xtensa_regs[XT_REG_IDX_CPENABLE].reg_num, XT_REG_A3));
 		xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_queue_dbg_reg_read(xtensa, XDMREG_DDR, regvals[XT_REG_IDX_CPENABLE].buf);
-	}
-	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
-	if (res != ERROR_OK) {
-		LOG_ERROR("Failed to read ARs (%d)!", res);
-		goto xtensa_fetch_all_regs_done;
-	}
-	xtensa_core_status_check(target);
 
-	a3 = buf_get_u32(a3_buf, 0, 32);
-	if (xtensa->core_config->core_type == XT_NX) {
-		a0 = buf_get_u32(a0_buf, 0, 32);
-		ms = buf_get_u32(ms_buf, 0, 32);
-	}
-
-	if (xtensa->core_config->coproc) {
-		cpenable = buf_get_u32(regvals[XT_REG_IDX_CPENABLE].buf, 0, 32);
-
-		/* Enable all coprocessors (by setting all bits in CPENABLE) so we can read FP and user registers. */
+		/* Enable all coprocessors (by setting all bits in CPENABLE) so we can read FP and user
+		 * registers in the same transaction. Whether the registers of a disabled coprocessor
+		 * are reported is decided from the original CPENABLE once everything is read. */
 		xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, 0xffffffff);
 		xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, xtensa_regs[XT_REG_IDX_CPENABLE].reg_num, XT_REG_A3));
-
-		/* Save CPENABLE; flag dirty later (when regcache updated) so original value is always restored */
-		LOG_TARGET_DEBUG(target, "CPENABLE: was 0x%" PRIx32 ", all enabled", cpenable);
-		xtensa_reg_set(target, XT_REG_IDX_CPENABLE, cpenable);
 	}
+	xtensa_reg_val_t cpenable_all = xtensa->core_config->coproc ? 0xffffffff : 0;
+
 	/* We're now free to use any of A0-A15 as scratch registers
 	 * Grab the SFRs and user registers first. We use A3 as a scratch register. */
 	for (unsigned int i = 0; i < reg_list_size; i++) {
 		struct xtensa_reg_desc *rlist = (i < XT_NUM_REGS) ? xtensa_regs : xtensa->optregs;
 		unsigned int ridx = (i < XT_NUM_REGS) ? i : i - XT_NUM_REGS;
-		if (xtensa_reg_is_readable(rlist[ridx].flags, cpenable) && rlist[ridx].exist) {
+		if (xtensa->lazy_regs && xtensa->lazy_regs[i])
+			continue;
+		if (xtensa_reg_is_readable(rlist[ridx].flags, cpenable_all) && rlist[ridx].exist) {
 			bool reg_fetched = true;
 			unsigned int reg_num = rlist[ridx].reg_num;
 			switch (rlist[ridx].type) {
@@ -1374,16 +1373,32 @@ int xtensa_fetch_all_regs(struct target *target)
 	/* Ok, send the whole mess to the CPU. */
 	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
 	if (res != ERROR_OK) {
-		LOG_ERROR("Failed to fetch AR regs!");
+		LOG_ERROR("Failed to fetch registers (%d)!", res);
 		goto xtensa_fetch_all_regs_done;
 	}
 	xtensa_core_status_check(target);
 
+	a3 = buf_get_u32(a3_buf, 0, 32);
+	if (xtensa->core_config->core_type == XT_NX) {
+		a0 = buf_get_u32(a0_buf, 0, 32);
+		ms = buf_get_u32(ms_buf, 0, 32);
+	}
+
+	if (xtensa->core_config->coproc) {
+		cpenable = buf_get_u32(regvals[XT_REG_IDX_CPENABLE].buf, 0, 32);
+
+		/* Save CPENABLE; flag dirty later (when regcache updated) so original value is always restored */
+		LOG_TARGET_DEBUG(target, "CPENABLE: was 0x%" PRIx32 ", all enabled", cpenable);
+		xtensa_reg_set(target, XT_REG_IDX_CPENABLE, cpenable);
+	}
+
 	if (debug_dsrs) {
 		/* DSR checking: follows order in which registers are requested. */
 		for (unsigned int i = 0; i < reg_list_size; i++) {
 			struct xtensa_reg_desc *rlist = (i < XT_NUM_REGS) ? xtensa_regs : xtensa->optregs;
 			unsigned int ridx = (i < XT_NUM_REGS) ? i : i - XT_NUM_REGS;
+			if (xtensa->lazy_regs && xtensa->lazy_regs[i])
+				continue;
 			if (xtensa_reg_is_readable(rlist[ridx].flags, cpenable) && rlist[ridx].exist &&
 				(rlist[ridx].type != XT_REG_DEBUG) &&
 				(rlist[ridx].type != XT_REG_RELGEN) &&
@@ -1411,6 +1426,13 @@ int xtensa_fetch_all_regs(struct target *target)
 	for (unsigned int i = 0; i < reg_list_size; i++) {
 		struct xtensa_reg_desc *rlist = (i < XT_NUM_REGS) ? xtensa_regs : xtensa->optregs;
 		unsigned int ridx = (i < XT_NUM_REGS) ? i : i - XT_NUM_REGS;
+		if (xtensa->lazy_regs && xtensa->lazy_regs[i]) {
+			/* fetched on first access, see xtensa_fetch_lazy_regs() */
+			reg_list[i].valid = false;
+			reg_list[i].dirty = false;
+			xtensa->lazy_regs_pending = true;
+			continue;
+		}
 		if (xtensa_reg_is_readable(rlist[ridx].flags, cpenable) && rlist[ridx].exist) {
 			if ((xtensa->core_config->windowed) && (rlist[ridx].type == XT_REG_GENERAL)) {
 				/* The 64-value general register set is read from (windowbase) on down.
@@ -1486,6 +1508,96 @@ xtensa_fetch_all_regs_done:
 	return res;
 }
 
+/* Read the lazy registers left out by xtensa_fetch_all_regs(), all in one transaction.
+ * Only user, FP and special registers are lazy, so A3 is the only scratch register. */
+static int xtensa_fetch_lazy_regs(struct target *target)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+	struct reg *reg_list = xtensa->core_cache->reg_list;
+	unsigned int reg_list_size = xtensa->core_cache->num_regs;
+	xtensa_reg_val_t cpenable = xtensa_reg_get(target, XT_REG_IDX_CPENABLE);
+	bool debug_dsrs = LOG_LEVEL_IS(LOG_LVL_DEBUG);
+	int res = ERROR_OK;
+
+	if (!xtensa->lazy_regs_pending)
+		return ERROR_OK;
+
+	union xtensa_reg_val_u *regvals = calloc(reg_list_size, sizeof(*regvals));
+	union xtensa_reg_val_u *dsrs = calloc(reg_list_size, sizeof(*dsrs));
+	if (!regvals || !dsrs) {
+		LOG_TARGET_ERROR(target, "unable to allocate memory for lazy registers!");
+		res = ERROR_FAIL;
+		goto xtensa_fetch_lazy_regs_done;
+	}
+
+	unsigned int count = 0;
+	for (unsigned int i = XT_NUM_REGS; i < reg_list_size; i++) {
+		struct xtensa_reg_desc *rdesc = &xtensa->optregs[i - XT_NUM_REGS];
+		if (!xtensa->lazy_regs[i] || reg_list[i].valid || !rdesc->exist ||
+			!xtensa_reg_is_readable(rdesc->flags, cpenable))
+			continue;
+		switch (rdesc->type) {
+		case XT_REG_USER:
+			xtensa_queue_exec_ins(xtensa, XT_INS_RUR(xtensa, rdesc->reg_num, XT_REG_A3));
+			break;
+		case XT_REG_FR:
+			xtensa_queue_exec_ins(xtensa, XT_INS_RFR(xtensa, rdesc->reg_num, XT_REG_A3));
+			break;
+		case XT_REG_SPECIAL:
+			xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, rdesc->reg_num, XT_REG_A3));
+			break;
+		default:
+			continue;
+		}
+		xtensa_queue_exec_ins(xtensa, XT_INS_WSR(xtensa, XT_SR_DDR, XT_REG_A3));
+		xtensa_queue_dbg_reg_read(xtensa, XDMREG_DDR, regvals[i].buf);
+		if (debug_dsrs)
+			xtensa_queue_dbg_reg_read(xtensa, XDMREG_DSR, dsrs[i].buf);
+		count++;
+	}
+
+	/* Put back A3 as cached by the last fetch, it is flagged for write-back already */
+	xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, xtensa_reg_get(target, XT_REG_IDX_A3));
+	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
+
+	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+	if (res != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Failed to fetch lazy registers (%d)!", res);
+		goto xtensa_fetch_lazy_regs_done;
+	}
+	xtensa_core_status_check(target);
+
+	for (unsigned int i = XT_NUM_REGS; i < reg_list_size; i++) {
+		struct xtensa_reg_desc *rdesc = &xtensa->optregs[i - XT_NUM_REGS];
+		if (!xtensa->lazy_regs[i] || reg_list[i].valid)
+			continue;
+		if (!rdesc->exist || !xtensa_reg_is_readable(rdesc->flags, cpenable) ||
+			(rdesc->type != XT_REG_USER && rdesc->type != XT_REG_FR &&
+			rdesc->type != XT_REG_SPECIAL)) {
+			if ((rdesc->flags & XT_REGF_MASK) == XT_REGF_NOREAD) {
+				/* Report read-only registers all-zero but valid */
+				buf_set_u32(reg_list[i].value, 0, 32, 0);
+				reg_list[i].valid = true;
+			}
+			continue;
+		}
+		if (debug_dsrs && (buf_get_u32(dsrs[i].buf, 0, 32) & OCDDSR_EXECEXCEPTION)) {
+			LOG_ERROR("Exception reading %s!", reg_list[i].name);
+			res = ERROR_FAIL;
+			goto xtensa_fetch_lazy_regs_done;
+		}
+		buf_cpy(regvals[i].buf, reg_list[i].value, reg_list[i].size);
+		reg_list[i].valid = true;
+	}
+
+	LOG_TARGET_DEBUG(target, "fetched %u lazy registers", count);
+	xtensa->lazy_regs_pending = false;
+xtensa_fetch_lazy_regs_done:
+	free(regvals);
+	free(dsrs);
+	return res;
+}
+
 int xtensa_get_gdb_reg_list(struct target *target,
 	struct reg **reg_list[],
 	int *reg_list_size,
@@ -2729,6 +2841,11 @@ int xtensa_start_algorithm(struct target *target,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* the whole context is restored after the algorithm */
+	retval = xtensa_fetch_lazy_regs(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	for (unsigned int i = 0; i < xtensa->core_cache->num_regs; i++) {
 		struct reg *reg = &xtensa->core_cache->reg_list[i];
 		buf_cpy(reg->value, xtensa->algo_context_backup[i], reg->size);
@@ -2834,6 +2951,10 @@ int xtensa_wait_algorithm(struct target *target,
 		LOG_ERROR("failed algorithm halted at 0x%" PRIx32 ", expected " TARGET_ADDR_FMT, pc, exit_point);
 		return ERROR_TARGET_TIMEOUT;
 	}
+	/* compare every register with the context saved before the algorithm */
+	retval = xtensa_fetch_lazy_regs(target);
+	if (retval != ERROR_OK)
+		return retval;
 	/* Copy core register values to reg_params[] */
 	for (int i = 0; i < num_reg_params; i++) {
 		if (reg_params[i].direction != PARAM_OUT) {
@@ -3051,6 +3172,30 @@ static int xtensa_build_reg_cache(struct target *target)
 		}
 	}
 
+	/* Only the GDB general packet and the optional registers used internally are read on
+	 * halt. Without a contiguous map all optional registers are lazy. */
+	xtensa->lazy_regs = calloc(reg_cache->num_regs, sizeof(bool));
+	if (!xtensa->lazy_regs) {
+		LOG_TARGET_ERROR(target, "ERROR: Out of memory");
+		goto fail;
+	}
+	for (unsigned int i = XT_NUM_REGS; i < reg_cache->num_regs; i++)
+		xtensa->lazy_regs[i] = true;
+	if (xtensa->contiguous_regs_list) {
+		for (unsigned int i = 0; i < xtensa->genpkt_regs_num; i++)
+			if (xtensa->contiguous_regs_list[i])
+				xtensa->lazy_regs[xtensa->contiguous_regs_list[i] - reg_list] = false;
+	}
+	if (xtensa->eps_dbglevel_idx)
+		xtensa->lazy_regs[xtensa->eps_dbglevel_idx] = false;
+	for (enum xtensa_nx_reg_idx idx = 0; idx < XT_NX_REG_IDX_NUM; idx++)
+		if (xtensa->nx_reg_idx[idx])
+			xtensa->lazy_regs[xtensa->nx_reg_idx[idx]] = false;
+	if (xtensa->nx_reg_idx[XT_NX_REG_IDX_IBREAKC0]) {
+		for (unsigned int slot = 1; slot < xtensa->core_config->debug.ibreaks_num; slot++)
+			xtensa->lazy_regs[xtensa->nx_reg_idx[XT_NX_REG_IDX_IBREAKC0] + slot] = false;
+	}
+
 	xtensa->algo_context_backup = calloc(reg_cache->num_regs, sizeof(void *));
 	if (!xtensa->algo_context_backup) {
 		LOG_ERROR("Failed to alloc mem for algorithm context backup!");
@@ -3087,6 +3232,8 @@ fail:
 			free(xtensa->algo_context_backup[i]);
 		free(xtensa->algo_context_backup);
 	}
+	free(xtensa->lazy_regs);
+	xtensa->lazy_regs = NULL;
 	free(reg_cache);
 
 	return ERROR_FAIL;
@@ -3465,6 +3612,9 @@ static void xtensa_free_reg_cache(struct target *target)
 	}
 	xtensa->core_cache = NULL;
 	xtensa->algo_context_backup = NULL;
+	free(xtensa->lazy_regs);
+	xtensa->lazy_regs = NULL;
+	xtensa->lazy_regs_pending = false;
 
 	if (xtensa->empty_regs) {
 		for (unsigned int i = 0; i < xtensa->dbregs_num; i++) {
@@ -285,6 +285,10 @@ struct xtensa {
 	uint32_t nx_reg_idx[XT_NX_REG_IDX_NUM];
 	struct xtensa_keyval_info scratch_ars[XT_AR_SCRATCH_NUM];
 	bool regs_fetched;	/* true after first register fetch completed successfully */
+	/* Registers outside the GDB general packet and the ones used internally are only
+	 * fetched on demand after a halt, see xtensa_fetch_lazy_regs(). Size is 'regs_num'. */
+	bool *lazy_regs;
+	bool lazy_regs_pending;	/* some lazy registers were not fetched since the last halt */
 };
 
 static inline struct xtensa *target_to_xtensa(struct target *target)